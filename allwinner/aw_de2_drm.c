@@ -90,6 +90,7 @@ static const struct file_operations aw_de2_drm_drv_fops = {
 	.poll = drm_poll,
 	.read = drm_read,
 	.mmap = drm_gem_cma_mmap,
+	.kqfilter = drm_kqfilter,
 	/* .llseek = noop_llseek, */
 };
 
@@ -240,8 +240,9 @@ aw_de2_mixer_attach(device_t dev)
 
 	sc->vi_planes = malloc(sizeof(struct aw_de2_mixer_plane) * sc->conf->vi_planes,
 	    DRM_MEM_DRIVER, M_WAITOK | M_ZERO);
-	sc->ui_planes = malloc(sizeof(struct aw_de2_mixer_plane) * sc->conf->ui_planes,
-	    DRM_MEM_DRIVER, M_WAITOK | M_ZERO);
+	sc->ui_planes = malloc(sizeof(struct aw_de2_mixer_plane) *
+	    sc->conf->ui_planes * OVL_UI_LAYERS, DRM_MEM_DRIVER,
+	    M_WAITOK | M_ZERO);
 
 	/* Clear all regs */
 	for (i = 0; i < 0x6000; i += 4)
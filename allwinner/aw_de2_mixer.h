@@ -65,7 +65,7 @@
 struct aw_de2_mixer_config {
 	char			*name;
 	size_t			vi_planes;
-	size_t			ui_planes;
+	size_t			ui_planes;	/* UI channels */
 	int			dst_tcon;
 };
 
@@ -73,6 +73,7 @@ struct aw_de2_mixer_plane {
 	struct drm_plane		plane;
 	struct aw_de2_mixer_softc	*sc;
 	int				id;
+	int				layer;
 };
 
 struct aw_de2_mixer_softc {
@@ -119,8 +119,6 @@ struct aw_de2_tcon_softc {
 	struct drm_crtc			crtc;
 	struct drm_encoder		encoder;
 
-	uint32_t	vbl_counter;
-
 	int	attach_done;
 };
 
@@ -230,16 +228,6 @@ aw_de2_tcon_disable_vblank(struct drm_crtc *crtc)
 	AW_DE2_TCON_WRITE_4(sc, TCON_GINT0, 0x00);
 }
 
-static uint32_t
-aw_de2_tcon_get_vblank_counter(struct drm_crtc *crtc)
-{
-	struct aw_de2_tcon_softc *sc;
-
-	sc = container_of(crtc, struct aw_de2_tcon_softc, crtc);
-
-	return (sc->vbl_counter);
-}
-
 static const struct drm_crtc_funcs aw_de2_tcon_funcs = {
 	.atomic_destroy_state	= drm_atomic_helper_crtc_destroy_state,
 	.atomic_duplicate_state	= drm_atomic_helper_crtc_duplicate_state,
@@ -248,7 +236,6 @@ static const struct drm_crtc_funcs aw_de2_tcon_funcs = {
 	.reset			= drm_atomic_helper_crtc_reset,
 	.set_config		= drm_atomic_helper_set_config,
 
-	.get_vblank_counter	= aw_de2_tcon_get_vblank_counter,
 	.enable_vblank		= aw_de2_tcon_enable_vblank,
 	.disable_vblank		= aw_de2_tcon_disable_vblank,
 };
@@ -509,7 +496,6 @@ aw_de2_tcon_intr(void *arg)
 		AW_DE2_TCON_WRITE_4(sc, TCON_GINT0,
 		    ~(TCON0_GINT0_VB_FLAG | TCON1_GINT0_VB_FLAG));
 
-		atomic_add_32(&sc->vbl_counter, 1);
 		drm_crtc_handle_vblank(&sc->crtc);
 	}
 }
@@ -48,6 +48,7 @@ __FBSDID("$FreeBSD$");
 #include <drm/drm_drv.h>
 #include <drm/drm_atomic.h>
 #include <drm/drm_atomic_helper.h>
+#include <drm/drm_damage_helper.h>
 #include <drm/drm_gem_framebuffer_helper.h>
 #include <drm/drm_plane_helper.h>
 #include <drm/drm_fb_cma_helper.h>
@@ -59,7 +60,8 @@ __FBSDID("$FreeBSD$");
 #include <dev/drm/allwinner/aw_de2_mixer.h>
 #include <dev/drm/allwinner/aw_de2_ui_plane.h>
 
-void aw_de2_ui_plane_dump_regs(struct aw_de2_mixer_softc *sc, int num);
+void aw_de2_ui_plane_dump_regs(struct aw_de2_mixer_softc *sc, int num,
+    int layer);
 
 static const u32 aw_de2_ui_plane_formats[] = {
 	DRM_FORMAT_ARGB8888,
@@ -84,23 +86,169 @@ static const u32 aw_de2_ui_plane_formats[] = {
 	DRM_FORMAT_BGRA5551,
 };
 
+/*
+ * Compute the channel window, the bounding box of all the visible layers of
+ * a UI channel, from their new state in the commit.  atomic_check adds every
+ * layer of the channel to the state, so the current state is only a fallback.
+ */
+static bool
+aw_de2_ui_channel_window(struct aw_de2_mixer_softc *sc, int channel,
+    struct drm_atomic_state *state, struct drm_rect *win)
+{
+	struct drm_plane_state *plane_state;
+	struct drm_plane *plane;
+	bool visible = false;
+	int layer;
+
+	for (layer = 0; layer < OVL_UI_LAYERS; layer++) {
+		plane = &sc->ui_planes[channel * OVL_UI_LAYERS + layer].plane;
+		plane_state = drm_atomic_get_new_plane_state(state, plane);
+		if (plane_state == NULL)
+			plane_state = plane->state;
+		if (plane_state == NULL || plane_state->crtc == NULL ||
+		    plane_state->fb == NULL || !plane_state->visible)
+			continue;
+
+		if (!visible) {
+			*win = plane_state->dst;
+			visible = true;
+			continue;
+		}
+		win->x1 = MIN(win->x1, plane_state->dst.x1);
+		win->y1 = MIN(win->y1, plane_state->dst.y1);
+		win->x2 = MAX(win->x2, plane_state->dst.x2);
+		win->y2 = MAX(win->y2, plane_state->dst.y2);
+	}
+
+	return (visible);
+}
+
 static int aw_de2_ui_plane_atomic_check(struct drm_plane *plane,
 				       struct drm_plane_state *state)
 {
+	struct aw_de2_mixer_plane *mixer_plane;
+	struct aw_de2_mixer_softc *sc;
+	struct drm_plane_state *sibling_state;
+	struct drm_plane *sibling;
 	struct drm_crtc *crtc = state->crtc;
 	struct drm_crtc_state *crtc_state;
+	struct drm_rect win;
+	int error, layer;
+
+	/*
+	 * The layers of a channel are blended into a single window which
+	 * goes through one blender pipe: any change to one layer can move
+	 * the window and so the position of the others.  Pull all of them
+	 * in the commit, locked, so the window is computed and programmed
+	 * from one consistent set of states.
+	 */
+	mixer_plane = container_of(plane, struct aw_de2_mixer_plane, plane);
+	sc = mixer_plane->sc;
+	for (layer = 0; layer < OVL_UI_LAYERS; layer++) {
+		sibling = &sc->ui_planes[mixer_plane->id * OVL_UI_LAYERS +
+		    layer].plane;
+		if (sibling == plane)
+			continue;
+		sibling_state = drm_atomic_get_plane_state(state->state,
+		    sibling);
+		if (IS_ERR(sibling_state))
+			return (PTR_ERR(sibling_state));
+	}
 
-	if (crtc == NULL)
+	if (crtc == NULL) {
+		/* disabled layer, don't leave a stale dst in the window */
+		state->visible = false;
 		return (0);
+	}
 
 	crtc_state = drm_atomic_get_existing_crtc_state(state->state, crtc);
 	if (crtc_state == NULL)
 		return (-EINVAL);
 
-	return drm_atomic_helper_check_plane_state(state, crtc_state,
+	error = drm_atomic_helper_check_plane_state(state, crtc_state,
 	    DRM_PLANE_HELPER_NO_SCALING,
 	    DRM_PLANE_HELPER_NO_SCALING,
 	    true, true);
+	if (error != 0 || !state->visible)
+		return (error);
+
+	/*
+	 * The layers must all be on the same crtc and the window must fit
+	 * in the window size registers.
+	 */
+	for (layer = 0; layer < OVL_UI_LAYERS; layer++) {
+		sibling = &sc->ui_planes[mixer_plane->id * OVL_UI_LAYERS +
+		    layer].plane;
+		if (sibling == plane)
+			continue;
+		sibling_state = drm_atomic_get_new_plane_state(state->state,
+		    sibling);
+		if (sibling_state->crtc != NULL && sibling_state->crtc != crtc) {
+			DRM_DEBUG_ATOMIC("UI channel %d layers on two crtcs\n",
+			    mixer_plane->id);
+			return (-EINVAL);
+		}
+	}
+
+	aw_de2_ui_channel_window(sc, mixer_plane->id, state->state, &win);
+	if (drm_rect_width(&win) > OVL_UI_SIZE_MAX ||
+	    drm_rect_height(&win) > OVL_UI_SIZE_MAX) {
+		DRM_DEBUG_ATOMIC("UI channel %d window too large\n",
+		    mixer_plane->id);
+		return (-EINVAL);
+	}
+
+	return (0);
+}
+
+/*
+ * Program the channel window and the position of every visible layer in it,
+ * using the layer states of the commit being applied.
+ */
+static void
+aw_de2_ui_channel_update(struct aw_de2_mixer_softc *sc, int channel,
+    struct drm_atomic_state *commit, bool primary)
+{
+	struct drm_plane_state *state;
+	struct drm_plane *plane;
+	struct drm_rect win;
+	uint32_t win_w, win_h;
+	int layer;
+
+	if (!aw_de2_ui_channel_window(sc, channel, commit, &win))
+		return;
+
+	win_w = drm_rect_width(&win);
+	win_h = drm_rect_height(&win);
+
+	DRM_DEBUG_DRIVER("%s: UI channel %d window %dx%d at %d,%d\n",
+	    __func__, channel, win_w, win_h, win.x1, win.y1);
+
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_SIZE(channel),
+	  ((win_h - 1) << 16) | (win_w - 1));
+
+	if (primary) {
+		AW_DE2_MIXER_WRITE_4(sc, GBL_SIZE,
+		  ((win_h - 1) << 16) | (win_w - 1));
+		AW_DE2_MIXER_WRITE_4(sc, BLD_OUTSIZE,
+		  ((win_h - 1) << 16) | (win_w - 1));
+	}
+	AW_DE2_MIXER_WRITE_4(sc, BLD_INSIZE(channel),
+	  ((win_h - 1) << 16) | (win_w - 1));
+	AW_DE2_MIXER_WRITE_4(sc, BLD_COORD(channel),
+	  win.y1 << 16 | win.x1);
+
+	for (layer = 0; layer < OVL_UI_LAYERS; layer++) {
+		plane = &sc->ui_planes[channel * OVL_UI_LAYERS + layer].plane;
+		state = drm_atomic_get_new_plane_state(commit, plane);
+		if (state == NULL)
+			state = plane->state;
+		if (state == NULL || state->crtc == NULL ||
+		    state->fb == NULL || !state->visible)
+			continue;
+		AW_DE2_MIXER_WRITE_4(sc, OVL_UI_COORD(channel, layer),
+		  (state->dst.y1 - win.y1) << 16 | (state->dst.x1 - win.x1));
+	}
 }
 
 static void aw_de2_ui_plane_atomic_disable(struct drm_plane *plane,
@@ -109,13 +257,19 @@ static void aw_de2_ui_plane_atomic_disable(struct drm_plane *plane,
 	struct aw_de2_mixer_plane *mixer_plane;
 	struct aw_de2_mixer_softc *sc;
 	uint32_t reg;
+	int id, layer;
 
 	mixer_plane = container_of(plane, struct aw_de2_mixer_plane, plane);
 	sc = mixer_plane->sc;
+	id = mixer_plane->id;
+	layer = mixer_plane->layer;
 
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(mixer_plane->id));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(id, layer));
 	reg &= ~OVL_UI_ATTR_EN;
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_ATTR_CTL(mixer_plane->id), reg);
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_ATTR_CTL(id, layer), reg);
+
+	/* Shrink the window to the remaining layers */
+	aw_de2_ui_channel_update(sc, id, old_state->state, false);
 }
 
 static void aw_de2_ui_plane_atomic_update(struct drm_plane *plane,
@@ -129,13 +283,14 @@ static void aw_de2_ui_plane_atomic_update(struct drm_plane *plane,
 	struct drm_gem_cma_object *bo;
 	dma_addr_t paddr;
 	uint32_t reg;
-	int id, i;
+	int id, layer, i;
 
 	mixer_plane = container_of(plane, struct aw_de2_mixer_plane, plane);
 	fb = container_of(plane->state->fb, struct drm_fb_cma, drm_fb);
 
 	sc = mixer_plane->sc;
 	id = mixer_plane->id;
+	layer = mixer_plane->layer;
 
 	DRM_DEBUG_DRIVER("%s: plane=%p fb=%p\n", __func__, plane, fb);
 
@@ -145,10 +300,12 @@ static void aw_de2_ui_plane_atomic_update(struct drm_plane *plane,
 	dst_h = drm_rect_height(&state->dst);
 
 	if (!plane->state->visible) {
-		DRM_DEBUG_DRIVER("%s: Disabling UI layer %d\n", __func__, id);
-		reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(id));
-		AW_DE2_MIXER_WRITE_4(sc, OVL_UI_ATTR_CTL(id),
+		DRM_DEBUG_DRIVER("%s: Disabling UI layer %d.%d\n", __func__,
+		    id, layer);
+		reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(id, layer));
+		AW_DE2_MIXER_WRITE_4(sc, OVL_UI_ATTR_CTL(id, layer),
 		  reg & ~OVL_UI_ATTR_EN);
+		aw_de2_ui_channel_update(sc, id, old_state->state, false);
 		return;
 	}
 
@@ -161,21 +318,12 @@ static void aw_de2_ui_plane_atomic_update(struct drm_plane *plane,
 	    __func__,
 	    dst_w, dst_h);
 
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_MBSIZE(id),
-	  ((src_h - 1) << 16) | (src_w - 1));
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_SIZE(id),
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_MBSIZE(id, layer),
 	  ((src_h - 1) << 16) | (src_w - 1));
 
-	if (plane->type == DRM_PLANE_TYPE_PRIMARY) {
-		AW_DE2_MIXER_WRITE_4(sc, GBL_SIZE,
-		  ((dst_h - 1) << 16) | (dst_w - 1));
-		AW_DE2_MIXER_WRITE_4(sc, BLD_OUTSIZE,
-		  ((dst_h - 1) << 16) | (dst_w - 1));
-	}
-	AW_DE2_MIXER_WRITE_4(sc, BLD_INSIZE(id),
-	  ((dst_h - 1) << 16) | (dst_w - 1));
-	AW_DE2_MIXER_WRITE_4(sc, BLD_COORD(id),
-	  state->dst.y1 << 16 | state->dst.x1);
+	/* Window size and layer coordinates */
+	aw_de2_ui_channel_update(sc, id, old_state->state,
+	    plane->type == DRM_PLANE_TYPE_PRIMARY);
 
 	/* Update addr and pitch */
 	bo = drm_fb_cma_get_gem_obj(fb, 0);
@@ -187,25 +335,31 @@ static void aw_de2_ui_plane_atomic_update(struct drm_plane *plane,
 	paddr += (state->src.x1 >> 16) * fb->drm_fb.format->cpp[0];
 	paddr += (state->src.y1 >> 16) * fb->drm_fb.pitches[0];
 
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_TOP_LADD(id), paddr & 0xFFFFFFFF);
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_BOT_LADD(id), 0);
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_TOP_HADD(id), 0);
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_BOT_HADD(id), 0);
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_PITCH(id), fb->drm_fb.pitches[0]);
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_TOP_LADD(id, layer),
+	  paddr & 0xFFFFFFFF);
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_BOT_LADD(id, layer), 0);
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_TOP_HADD(id));
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_TOP_HADD(id),
+	  reg & ~OVL_UI_HADD_MASK(layer));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_BOT_HADD(id));
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_BOT_HADD(id),
+	  reg & ~OVL_UI_HADD_MASK(layer));
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_PITCH(id, layer),
+	  fb->drm_fb.pitches[0]);
 
 	/* Update format */
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(id));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(id, layer));
 	reg &= ~OVL_UI_PIX_FORMAT_MASK;
 	for (i = 0; i < nitems(aw_de2_ui_plane_formats); i++)
 		if (aw_de2_ui_plane_formats[i] == state->fb->format->format)
 			break;
 	reg |= i << OVL_UI_PIX_FORMAT_SHIFT;
 
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_ATTR_CTL(id), reg);
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_ATTR_CTL(id, layer), reg);
 
 	/* Enable overlay */
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(id));
-	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_ATTR_CTL(id),
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(id, layer));
+	AW_DE2_MIXER_WRITE_4(sc, OVL_UI_ATTR_CTL(id, layer),
 	  reg | OVL_UI_ATTR_EN);
 
 	/* Enable pipe0 */
@@ -220,10 +374,11 @@ static void aw_de2_ui_plane_atomic_update(struct drm_plane *plane,
 	AW_DE2_MIXER_WRITE_4(sc, BLD_CH_ROUTING, reg);
 
 	if (__drm_debug & DRM_UT_DRIVER)
-		aw_de2_ui_plane_dump_regs(sc, 0);
+		aw_de2_ui_plane_dump_regs(sc, id, layer);
 }
 
 static struct drm_plane_helper_funcs aw_de2_ui_plane_helper_funcs = {
+	.prepare_fb	= drm_gem_fb_flush_prepare_fb,
 	.atomic_check	= aw_de2_ui_plane_atomic_check,
 	.atomic_disable	= aw_de2_ui_plane_atomic_disable,
 	.atomic_update	= aw_de2_ui_plane_atomic_update,
@@ -241,57 +396,64 @@ static const struct drm_plane_funcs aw_de2_ui_plane_funcs = {
 int
 aw_de2_ui_plane_create(struct aw_de2_mixer_softc *sc, struct drm_device *drm)
 {
+	struct aw_de2_mixer_plane *mixer_plane;
 	enum drm_plane_type type = DRM_PLANE_TYPE_PRIMARY;
-	int i;
+	int i, layer;
 
+	/* Every layer of every UI channel is a plane, layer 0.0 is primary */
 	for (i = 0; i < sc->conf->ui_planes; i++) {
-		if (i > 0)
-			type = DRM_PLANE_TYPE_OVERLAY;
-		drm_universal_plane_init(drm,
-		    &sc->ui_planes[i].plane,
-		    0,
-		    &aw_de2_ui_plane_funcs,
-		    aw_de2_ui_plane_formats,
-		    nitems(aw_de2_ui_plane_formats),
-		    NULL, type, NULL);
-
-		drm_plane_helper_add(&sc->ui_planes[i].plane,
-		    &aw_de2_ui_plane_helper_funcs);
-
-		sc->ui_planes[i].sc= sc;
-		sc->ui_planes[i].id = i;
+		for (layer = 0; layer < OVL_UI_LAYERS; layer++) {
+			mixer_plane = &sc->ui_planes[i * OVL_UI_LAYERS + layer];
+			if (i > 0 || layer > 0)
+				type = DRM_PLANE_TYPE_OVERLAY;
+			drm_universal_plane_init(drm,
+			    &mixer_plane->plane,
+			    0,
+			    &aw_de2_ui_plane_funcs,
+			    aw_de2_ui_plane_formats,
+			    nitems(aw_de2_ui_plane_formats),
+			    NULL, type, NULL);
+
+			drm_plane_helper_add(&mixer_plane->plane,
+			    &aw_de2_ui_plane_helper_funcs);
+			drm_plane_enable_fb_damage_clips(&mixer_plane->plane);
+
+			mixer_plane->sc = sc;
+			mixer_plane->id = i;
+			mixer_plane->layer = layer;
+		}
 	}
 
 	return (0);
 }
 
 void
-aw_de2_ui_plane_dump_regs(struct aw_de2_mixer_softc *sc, int num)
+aw_de2_ui_plane_dump_regs(struct aw_de2_mixer_softc *sc, int num, int layer)
 {
 	uint32_t reg;
 	int i;
 
-	DRM_DEBUG_DRIVER("%s: UI Plane %d\n", __func__, num);
+	DRM_DEBUG_DRIVER("%s: UI Plane %d layer %d\n", __func__, num, layer);
 
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(num));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_ATTR_CTL(num, layer));
 	DRM_DEBUG_DRIVER("%s: ATTR_CTL(%d): %x\n", __func__, num, reg);
 
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_MBSIZE(num));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_MBSIZE(num, layer));
 	DRM_DEBUG_DRIVER("%s: MBSIZE(%d): %x (%dx%d)\n", __func__, num, reg,
 	  (reg & OVL_UI_MBSIZE_WIDTH_MASK) >> OVL_UI_MBSIZE_WIDTH_SHIFT,
 	  (reg & OVL_UI_MBSIZE_HEIGHT_MASK) >> OVL_UI_MBSIZE_HEIGHT_SHIFT);
 
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_COORD(num));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_COORD(num, layer));
 	DRM_DEBUG_DRIVER("%s: COOR(%d): %x (%d %d)\n", __func__, num, reg,
 	    (reg & OVL_UI_COOR_X_MASK) >> OVL_UI_COOR_X_SHIFT,
 	    (reg & OVL_UI_COOR_Y_MASK) >> OVL_UI_COOR_Y_SHIFT);
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_PITCH(num));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_PITCH(num, layer));
 	DRM_DEBUG_DRIVER("%s: PITCH(%d): %d\n", __func__, num, reg);
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_TOP_LADD(num));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_TOP_LADD(num, layer));
 	DRM_DEBUG_DRIVER("%s: TOP_LADD(%d): %x\n", __func__, num, reg);
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_BOT_LADD(num));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_BOT_LADD(num, layer));
 	DRM_DEBUG_DRIVER("%s: BOT_LADD(%d): %x\n", __func__, num, reg);
-	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_FILL_COLOR(num));
+	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_FILL_COLOR(num, layer));
 	DRM_DEBUG_DRIVER("%s: FILL_COLOR(%d): %x\n", __func__, num, reg);
 	reg = AW_DE2_MIXER_READ_4(sc, OVL_UI_TOP_HADD(num));
 	DRM_DEBUG_DRIVER("%s: TOP_HADD(%d): %x\n", __func__, num, reg);
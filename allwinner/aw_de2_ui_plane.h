@@ -32,9 +32,15 @@
 #define	OVL_UI_BASE	0x3000
 #define	OVL_UI_CHANNEL_SIZE	0x1000
 
+/* Each UI channel has four layers, blended into one channel window */
+#define	OVL_UI_LAYERS		4
+#define	OVL_UI_LAYER_SIZE	0x20
+
 #define	OVL_UI_CH_BASE(channel)	(OVL_UI_BASE + (channel * OVL_UI_CHANNEL_SIZE))
+#define	OVL_UI_LAYER_BASE(channel, layer)	\
+	(OVL_UI_CH_BASE(channel) + (layer * OVL_UI_LAYER_SIZE))
 
-#define	OVL_UI_ATTR_CTL(channel)	(OVL_UI_CH_BASE(channel))
+#define	OVL_UI_ATTR_CTL(channel, layer)	(OVL_UI_LAYER_BASE(channel, layer))
 #define	 OVL_UI_ATTR_EN			(1 << 0)
 #define	 OVL_UI_ATTR_ALPHA_MASK		0x6
 #define	 OVL_UI_ATTR_ALPHA_SHIFT	1
@@ -44,30 +50,35 @@
 #define	 OVL_UI_PIX_FORMAT_MASK		0x1F00
 #define	 OVL_UI_PIX_FORMAT_SHIFT	8
 
-#define	OVL_UI_MBSIZE(channel)	(OVL_UI_CH_BASE(channel) + 0x04)
+#define	OVL_UI_MBSIZE(channel, layer)	(OVL_UI_LAYER_BASE(channel, layer) + 0x04)
 #define	 OVL_UI_MBSIZE_WIDTH_MASK	0x1FFF
 #define	 OVL_UI_MBSIZE_WIDTH_SHIFT	0
 #define	 OVL_UI_MBSIZE_HEIGHT_MASK	0x1FFF0000
 #define	 OVL_UI_MBSIZE_HEIGHT_SHIFT	16
 
-#define	OVL_UI_COORD(channel)		(OVL_UI_CH_BASE(channel) + 0x08)
+#define	OVL_UI_COORD(channel, layer)	(OVL_UI_LAYER_BASE(channel, layer) + 0x08)
 #define	 OVL_UI_COOR_X_MASK	0xFFFF
 #define	 OVL_UI_COOR_X_SHIFT	0
 #define	 OVL_UI_COOR_Y_MASK	0xFFFF0000
 #define	 OVL_UI_COOR_Y_SHIFT	16
 
-#define	OVL_UI_PITCH(channel)		(OVL_UI_CH_BASE(channel) + 0x0C)
-#define	OVL_UI_TOP_LADD(channel)	(OVL_UI_CH_BASE(channel) + 0x10)
-#define	OVL_UI_BOT_LADD(channel)	(OVL_UI_CH_BASE(channel) + 0x14)
-#define	OVL_UI_FILL_COLOR(channel)	(OVL_UI_CH_BASE(channel) + 0x18)
+#define	OVL_UI_PITCH(channel, layer)	(OVL_UI_LAYER_BASE(channel, layer) + 0x0C)
+#define	OVL_UI_TOP_LADD(channel, layer)	(OVL_UI_LAYER_BASE(channel, layer) + 0x10)
+#define	OVL_UI_BOT_LADD(channel, layer)	(OVL_UI_LAYER_BASE(channel, layer) + 0x14)
+#define	OVL_UI_FILL_COLOR(channel, layer)	(OVL_UI_LAYER_BASE(channel, layer) + 0x18)
+
+/* High address bytes of the four layers, one byte per layer */
 #define	OVL_UI_TOP_HADD(channel)	(OVL_UI_CH_BASE(channel) + 0x80)
 #define	OVL_UI_BOT_HADD(channel)	(OVL_UI_CH_BASE(channel) + 0x84)
+#define	 OVL_UI_HADD_MASK(layer)	(0xFF << ((layer) * 8))
 
+/* Size of the channel window, shared by all layers */
 #define	OVL_UI_SIZE(channel)		(OVL_UI_CH_BASE(channel) + 0x88)
 #define	 OVL_UI_SIZE_WIDTH_MASK		0x1FFF
 #define	 OVL_UI_SIZE_WIDTH_SHIFT	0
 #define	 OVL_UI_SIZE_HEIGHT_MASK	0x1FFF0000
 #define	 OVL_UI_SIZE_HEIGHT_SHIFT	16
+#define	 OVL_UI_SIZE_MAX		8192
 
 int aw_de2_ui_plane_create(struct aw_de2_mixer_softc *sc, struct drm_device *drm);
 
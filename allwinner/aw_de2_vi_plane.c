@@ -48,6 +48,7 @@ __FBSDID("$FreeBSD$");
 #include <drm/drm_drv.h>
 #include <drm/drm_atomic.h>
 #include <drm/drm_atomic_helper.h>
+#include <drm/drm_damage_helper.h>
 #include <drm/drm_gem_framebuffer_helper.h>
 #include <drm/drm_plane_helper.h>
 #include <drm/drm_fb_helper.h>
@@ -322,6 +323,7 @@ aw_de2_vi_plane_atomic_update(struct drm_plane *plane,
 }
 
 static struct drm_plane_helper_funcs aw_de2_vi_plane_helper_funcs = {
+	.prepare_fb	= drm_gem_fb_flush_prepare_fb,
 	.atomic_check	= aw_de2_vi_plane_atomic_check,
 	.atomic_disable	= aw_de2_vi_plane_atomic_disable,
 	.atomic_update	= aw_de2_vi_plane_atomic_update,
@@ -352,6 +354,7 @@ aw_de2_vi_plane_create(struct aw_de2_mixer_softc *sc, struct drm_device *drm)
 
 		drm_plane_helper_add(&sc->vi_planes[i].plane,
 		    &aw_de2_vi_plane_helper_funcs);
+		drm_plane_enable_fb_damage_clips(&sc->vi_planes[i].plane);
 
 		sc->vi_planes[i].sc = sc;
 		sc->vi_planes[i].id = sc->conf->ui_planes + i;
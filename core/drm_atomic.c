@@ -1261,6 +1261,7 @@ int drm_atomic_check_only(struct drm_atomic_state *state)
 	struct drm_crtc_state *new_crtc_state;
 	struct drm_connector *conn;
 	struct drm_connector_state *conn_state;
+	ktime_t start = drm_commit_stats_start();
 	int i, ret = 0;
 
 	DRM_DEBUG_ATOMIC("checking %p\n", state);
@@ -1312,6 +1313,8 @@ int drm_atomic_check_only(struct drm_atomic_state *state)
 		}
 	}
 
+	drm_commit_stats_record(state, DRM_COMMIT_PHASE_CHECK, start);
+
 	return 0;
 }
 EXPORT_SYMBOL(drm_atomic_check_only);
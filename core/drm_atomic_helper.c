@@ -1270,11 +1270,15 @@ crtc_set_mode(struct drm_device *dev, struct drm_atomic_state *old_state)
 void drm_atomic_helper_commit_modeset_disables(struct drm_device *dev,
 					       struct drm_atomic_state *old_state)
 {
+	ktime_t start = drm_commit_stats_start();
+
 	disable_outputs(dev, old_state);
 
 	drm_atomic_helper_update_legacy_modeset_state(dev, old_state);
 
 	crtc_set_mode(dev, old_state);
+
+	drm_commit_stats_record(old_state, DRM_COMMIT_PHASE_DISABLES, start);
 }
 EXPORT_SYMBOL(drm_atomic_helper_commit_modeset_disables);
 
@@ -1321,6 +1325,7 @@ void drm_atomic_helper_commit_modeset_enables(struct drm_device *dev,
 	struct drm_crtc_state *new_crtc_state;
 	struct drm_connector *connector;
 	struct drm_connector_state *new_conn_state;
+	ktime_t start = drm_commit_stats_start();
 	int i;
 
 	for_each_oldnew_crtc_in_state(old_state, crtc, old_crtc_state, new_crtc_state, i) {
@@ -1383,9 +1388,53 @@ void drm_atomic_helper_commit_modeset_enables(struct drm_device *dev,
 	}
 
 	drm_atomic_helper_commit_writebacks(dev, old_state);
+
+	drm_commit_stats_record(old_state, DRM_COMMIT_PHASE_ENABLES, start);
 }
 EXPORT_SYMBOL(drm_atomic_helper_commit_modeset_enables);
 
+/*
+ * Tell the producers of the plane in-fences when the result is needed: at
+ * the start of the earliest next vblank among the CRTCs being updated.
+ * Modesets are skipped, their vblank timing is about to change.
+ */
+static void set_fence_deadline(struct drm_device *dev,
+			       struct drm_atomic_state *state)
+{
+	struct drm_crtc *crtc;
+	struct drm_crtc_state *new_crtc_state;
+	struct drm_plane *plane;
+	struct drm_plane_state *new_plane_state;
+	ktime_t vbltime = 0;
+	int i;
+
+	for_each_new_crtc_in_state(state, crtc, new_crtc_state, i) {
+		ktime_t v;
+
+		if (drm_atomic_crtc_needs_modeset(new_crtc_state))
+			continue;
+
+		if (!new_crtc_state->active)
+			continue;
+
+		if (drm_crtc_next_vblank_start(crtc, &v))
+			continue;
+
+		if (!vbltime || ktime_before(v, vbltime))
+			vbltime = v;
+	}
+
+	/* If no CRTCs updated, then nothing to do: */
+	if (!vbltime)
+		return;
+
+	for_each_new_plane_in_state(state, plane, new_plane_state, i) {
+		if (!new_plane_state->fence)
+			continue;
+		dma_fence_set_deadline(new_plane_state->fence, vbltime);
+	}
+}
+
 /**
  * drm_atomic_helper_wait_for_fences - wait for fences stashed in plane state
  * @dev: DRM device
@@ -1413,8 +1462,12 @@ int drm_atomic_helper_wait_for_fences(struct drm_device *dev,
 {
 	struct drm_plane *plane;
 	struct drm_plane_state *new_plane_state;
+	ktime_t start = drm_commit_stats_start();
+	bool waited = false;
 	int i, ret;
 
+	set_fence_deadline(dev, state);
+
 	for_each_new_plane_in_state(state, plane, new_plane_state, i) {
 		if (!new_plane_state->fence)
 			continue;
@@ -1432,8 +1485,16 @@ int drm_atomic_helper_wait_for_fences(struct drm_device *dev,
 
 		dma_fence_put(new_plane_state->fence);
 		new_plane_state->fence = NULL;
+		waited = true;
 	}
 
+	/*
+	 * Blocking commits call this twice, the fences are gone by the
+	 * second call: only account the call which did wait.
+	 */
+	if (waited)
+		drm_commit_stats_record(state, DRM_COMMIT_PHASE_FENCES, start);
+
 	return 0;
 }
 EXPORT_SYMBOL(drm_atomic_helper_wait_for_fences);
@@ -1459,6 +1520,7 @@ drm_atomic_helper_wait_for_vblanks(struct drm_device *dev,
 {
 	struct drm_crtc *crtc;
 	struct drm_crtc_state *old_crtc_state, *new_crtc_state;
+	ktime_t start;
 	int i, ret;
 	unsigned crtc_mask = 0;
 
@@ -1469,6 +1531,8 @@ drm_atomic_helper_wait_for_vblanks(struct drm_device *dev,
 	if (old_state->legacy_cursor_update)
 		return;
 
+	start = drm_commit_stats_start();
+
 	for_each_oldnew_crtc_in_state(old_state, crtc, old_crtc_state, new_crtc_state, i) {
 		if (!new_crtc_state->active)
 			continue;
@@ -1492,9 +1556,13 @@ drm_atomic_helper_wait_for_vblanks(struct drm_device *dev,
 
 		WARN(!ret, "[CRTC:%d:%s] vblank wait timed out\n",
 		     crtc->base.id, crtc->name);
+		if (ret)
+			drm_commit_stats_flip_landed(old_state, i);
 
 		drm_crtc_vblank_put(crtc);
 	}
+
+	drm_commit_stats_record(old_state, DRM_COMMIT_PHASE_VBLANKS, start);
 }
 EXPORT_SYMBOL(drm_atomic_helper_wait_for_vblanks);
 
@@ -1529,9 +1597,13 @@ void drm_atomic_helper_wait_for_flip_done(struct drm_device *dev,
 			continue;
 
 		ret = wait_for_completion_timeout(&commit->flip_done, 10 * HZ);
-		if (ret == 0)
+		if (ret == 0) {
 			DRM_ERROR("[CRTC:%d:%s] flip_done timed out\n",
 				  crtc->base.id, crtc->name);
+			drm_debug_record_dump();
+		} else {
+			drm_commit_stats_flip_landed(old_state, i);
+		}
 	}
 
 	if (old_state->fake_commit)
@@ -1621,6 +1693,9 @@ static void commit_tail(struct drm_atomic_state *old_state)
 
 	drm_atomic_helper_commit_cleanup_done(old_state);
 
+	drm_commit_stats_record(old_state, DRM_COMMIT_PHASE_TOTAL,
+				old_state->commit_start);
+
 	drm_atomic_state_put(old_state);
 }
 
@@ -1762,6 +1837,7 @@ int drm_atomic_helper_commit(struct drm_device *dev,
 			     struct drm_atomic_state *state,
 			     bool nonblock)
 {
+	ktime_t start;
 	int ret;
 
 	if (state->async_update) {
@@ -1775,15 +1851,22 @@ int drm_atomic_helper_commit(struct drm_device *dev,
 		return 0;
 	}
 
+	state->commit_start = drm_commit_stats_start();
+	drm_commit_stats_set_targets(state);
+
+	start = drm_commit_stats_start();
 	ret = drm_atomic_helper_setup_commit(state, nonblock);
 	if (ret)
 		return ret;
+	drm_commit_stats_record(state, DRM_COMMIT_PHASE_SETUP, start);
 
 	INIT_WORK(&state->commit_work, commit_work);
 
+	start = drm_commit_stats_start();
 	ret = drm_atomic_helper_prepare_planes(dev, state);
 	if (ret)
 		return ret;
+	drm_commit_stats_record(state, DRM_COMMIT_PHASE_PREPARE, start);
 
 	if (!nonblock) {
 		ret = drm_atomic_helper_wait_for_fences(dev, state, true);
@@ -1923,9 +2006,11 @@ static int stall_checks(struct drm_crtc *crtc, bool nonblock)
 	 */
 	ret = wait_for_completion_interruptible_timeout(&stall_commit->cleanup_done,
 							10*HZ);
-	if (ret == 0)
+	if (ret == 0) {
 		DRM_ERROR("[CRTC:%d:%s] cleanup_done timed out\n",
 			  crtc->base.id, crtc->name);
+		drm_debug_record_dump();
+	}
 
 	drm_crtc_commit_put(stall_commit);
 
@@ -2129,6 +2214,8 @@ void drm_atomic_helper_wait_for_dependencies(struct drm_atomic_state *old_state)
 	struct drm_connector *conn;
 	struct drm_connector_state *old_conn_state;
 	struct drm_crtc_commit *commit;
+	ktime_t start = drm_commit_stats_start();
+	bool timed_out = false;
 	int i;
 	long ret;
 
@@ -2140,17 +2227,21 @@ void drm_atomic_helper_wait_for_dependencies(struct drm_atomic_state *old_state)
 
 		ret = wait_for_completion_timeout(&commit->hw_done,
 						  10*HZ);
-		if (ret == 0)
+		if (ret == 0) {
 			DRM_ERROR("[CRTC:%d:%s] hw_done timed out\n",
 				  crtc->base.id, crtc->name);
+			timed_out = true;
+		}
 
 		/* Currently no support for overwriting flips, hence
 		 * stall for previous one to execute completely. */
 		ret = wait_for_completion_timeout(&commit->flip_done,
 						  10*HZ);
-		if (ret == 0)
+		if (ret == 0) {
 			DRM_ERROR("[CRTC:%d:%s] flip_done timed out\n",
 				  crtc->base.id, crtc->name);
+			timed_out = true;
+		}
 	}
 
 	for_each_old_connector_in_state(old_state, conn, old_conn_state, i) {
@@ -2161,17 +2252,21 @@ void drm_atomic_helper_wait_for_dependencies(struct drm_atomic_state *old_state)
 
 		ret = wait_for_completion_timeout(&commit->hw_done,
 						  10*HZ);
-		if (ret == 0)
+		if (ret == 0) {
 			DRM_ERROR("[CONNECTOR:%d:%s] hw_done timed out\n",
 				  conn->base.id, conn->name);
+			timed_out = true;
+		}
 
 		/* Currently no support for overwriting flips, hence
 		 * stall for previous one to execute completely. */
 		ret = wait_for_completion_timeout(&commit->flip_done,
 						  10*HZ);
-		if (ret == 0)
+		if (ret == 0) {
 			DRM_ERROR("[CONNECTOR:%d:%s] flip_done timed out\n",
 				  conn->base.id, conn->name);
+			timed_out = true;
+		}
 	}
 
 	for_each_old_plane_in_state(old_state, plane, old_plane_state, i) {
@@ -2182,18 +2277,28 @@ void drm_atomic_helper_wait_for_dependencies(struct drm_atomic_state *old_state)
 
 		ret = wait_for_completion_timeout(&commit->hw_done,
 						  10*HZ);
-		if (ret == 0)
+		if (ret == 0) {
 			DRM_ERROR("[PLANE:%d:%s] hw_done timed out\n",
 				  plane->base.id, plane->name);
+			timed_out = true;
+		}
 
 		/* Currently no support for overwriting flips, hence
 		 * stall for previous one to execute completely. */
 		ret = wait_for_completion_timeout(&commit->flip_done,
 						  10*HZ);
-		if (ret == 0)
+		if (ret == 0) {
 			DRM_ERROR("[PLANE:%d:%s] flip_done timed out\n",
 				  plane->base.id, plane->name);
+			timed_out = true;
+		}
 	}
+
+	if (timed_out)
+		drm_debug_record_dump();
+
+	drm_commit_stats_record(old_state, DRM_COMMIT_PHASE_DEPENDENCIES,
+				start);
 }
 EXPORT_SYMBOL(drm_atomic_helper_wait_for_dependencies);
 
@@ -2260,6 +2365,10 @@ void drm_atomic_helper_commit_hw_done(struct drm_atomic_state *old_state)
 	struct drm_crtc_commit *commit;
 	int i;
 
+	/* Time from submission until the hardware has been programmed. */
+	drm_commit_stats_record(old_state, DRM_COMMIT_PHASE_HW_DONE,
+				old_state->commit_start);
+
 	for_each_oldnew_crtc_in_state(old_state, crtc, old_crtc_state, new_crtc_state, i) {
 		commit = new_crtc_state->commit;
 		if (!commit)
@@ -2441,6 +2550,7 @@ void drm_atomic_helper_commit_planes(struct drm_device *dev,
 	struct drm_crtc_state *old_crtc_state, *new_crtc_state;
 	struct drm_plane *plane;
 	struct drm_plane_state *old_plane_state, *new_plane_state;
+	ktime_t start = drm_commit_stats_start();
 	int i;
 	bool active_only = flags & DRM_PLANE_COMMIT_ACTIVE_ONLY;
 	bool no_disable = flags & DRM_PLANE_COMMIT_NO_DISABLE_AFTER_MODESET;
@@ -2516,6 +2626,8 @@ void drm_atomic_helper_commit_planes(struct drm_device *dev,
 
 		funcs->atomic_flush(crtc, old_crtc_state);
 	}
+
+	drm_commit_stats_record(old_state, DRM_COMMIT_PHASE_PLANES, start);
 }
 EXPORT_SYMBOL(drm_atomic_helper_commit_planes);
 
@@ -2644,6 +2756,7 @@ void drm_atomic_helper_cleanup_planes(struct drm_device *dev,
 {
 	struct drm_plane *plane;
 	struct drm_plane_state *old_plane_state, *new_plane_state;
+	ktime_t start = drm_commit_stats_start();
 	int i;
 
 	for_each_oldnew_plane_in_state(old_state, plane, old_plane_state, new_plane_state, i) {
@@ -2664,6 +2777,8 @@ void drm_atomic_helper_cleanup_planes(struct drm_device *dev,
 		if (funcs->cleanup_fb)
 			funcs->cleanup_fb(plane, plane_state);
 	}
+
+	drm_commit_stats_record(old_state, DRM_COMMIT_PHASE_CLEANUP, start);
 }
 EXPORT_SYMBOL(drm_atomic_helper_cleanup_planes);
 
@@ -372,11 +372,7 @@ out:
  */
 bool drm_is_current_master(struct drm_file *fpriv)
 {
-#ifdef __linux__
 	return fpriv->is_master && drm_lease_owner(fpriv->master) == fpriv->minor->dev->master;
-#elif defined(__FreeBSD__)
-	return fpriv->is_master;
-#endif
 }
 EXPORT_SYMBOL(drm_is_current_master);
 
@@ -28,11 +28,23 @@
  * Authors: Thomas Hellström <thomas-at-tungstengraphics-dot-com>
  */
 
+#include <linux/dma-mapping.h>
 #include <linux/export.h>
 #include <linux/highmem.h>
 
 #include <drm/drm_cache.h>
 
+#ifdef __FreeBSD__
+#include <vm/vm.h>
+#include <vm/pmap.h>
+#include <vm/vm_page.h>
+#if defined(__aarch64__)
+#include <machine/cpufunc.h>
+#elif defined(__arm__)
+#include <machine/cpu.h>
+#endif
+#endif
+
 #if defined(CONFIG_X86)
 #include <asm/smp.h>
 
@@ -176,3 +188,62 @@ drm_clflush_virt_range(void *addr, unsigned long length)
 #endif
 }
 EXPORT_SYMBOL(drm_clflush_virt_range);
+
+#ifdef __FreeBSD__
+/**
+ * drm_cache_sync_pages - Maintain dcache lines of a byte range of pages
+ * @pages: Array of pages backing the buffer.
+ * @offset: Byte offset of the range from the start of @pages[0].
+ * @length: Range size.
+ * @dir: Direction of the device access the range is shared with.
+ * @for_cpu: True when the CPU takes the range over, false when it hands the
+ *           range back to the device.
+ *
+ * Only the cache lines overlapping the range are touched. Taking a range over
+ * for reading writes back and invalidates its lines, so the CPU does not see
+ * stale data and no dirty line straddling the range edges is lost. Handing a
+ * range back after writing it writes its lines back. Buffers mapped with a
+ * non-cacheable memory attribute must not be passed in.
+ */
+void
+drm_cache_sync_pages(struct page *pages[], unsigned long offset,
+		     unsigned long length, enum dma_data_direction dir,
+		     bool for_cpu)
+{
+#if defined(__aarch64__) || defined(__arm__)
+	unsigned long chunk, poff;
+	vm_offset_t va;
+	struct page *page;
+
+	if (for_cpu && dir == DMA_TO_DEVICE)
+		return;
+	if (!for_cpu && dir == DMA_FROM_DEVICE)
+		return;
+
+	pages += offset / PAGE_SIZE;
+	poff = offset % PAGE_SIZE;
+	while (length > 0) {
+		chunk = min_t(unsigned long, length, PAGE_SIZE - poff);
+		page = *pages++;
+		va = pmap_quick_enter_page(page);
+#if defined(__aarch64__)
+		if (for_cpu)
+			cpu_dcache_wbinv_range(va + poff, chunk);
+		else
+			cpu_dcache_wb_range(va + poff, chunk);
+#else
+		if (for_cpu)
+			dcache_wbinv_poc(va + poff,
+					 VM_PAGE_TO_PHYS(page) + poff, chunk);
+		else
+			dcache_wb_poc(va + poff,
+				      VM_PAGE_TO_PHYS(page) + poff, chunk);
+#endif
+		pmap_quick_remove_page(va);
+		length -= chunk;
+		poff = 0;
+	}
+#endif
+}
+EXPORT_SYMBOL(drm_cache_sync_pages);
+#endif
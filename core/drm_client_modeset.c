@@ -8,10 +8,13 @@
  */
 
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <drm/drm_atomic.h>
+#include <drm/drm_boot_timeline.h>
 #include <drm/drm_client.h>
 #include <drm/drm_connector.h>
 #include <drm/drm_crtc.h>
@@ -25,10 +28,24 @@
 
 #define DRM_CLIENT_MAX_CLONED_CONNECTORS	8
 
+static bool drm_client_parallel_probe = true;
+module_param_named(parallel_probe, drm_client_parallel_probe, bool, 0600);
+#ifdef __FreeBSD__
+MODULE_PARM_DESC(parallel_probe,
+    "Probe connectors concurrently during the initial configuration");
+#endif
+
 struct drm_client_offset {
 	int x, y;
 };
 
+struct drm_client_probe_work {
+	struct work_struct work;
+	struct drm_connector *connector;
+	unsigned int width, height;
+	int count;
+};
+
 int drm_client_modeset_create(struct drm_client_dev *client)
 {
 	struct drm_device *dev = client->dev;
@@ -746,6 +763,82 @@ bail:
 	return ret;
 }
 
+static int drm_client_probe_connector(struct drm_connector *connector,
+				      unsigned int width, unsigned int height)
+{
+	struct drm_device *dev = connector->dev;
+	int count;
+
+	drm_boot_timeline_record(dev, DRM_BOOT_PROBE_START, connector->name);
+	count = connector->funcs->fill_modes(connector, width, height);
+	drm_boot_timeline_record(dev, DRM_BOOT_PROBE_END, connector->name);
+
+	return count;
+}
+
+static void drm_client_probe_work_fn(struct work_struct *work)
+{
+	struct drm_client_probe_work *probe =
+		container_of(work, struct drm_client_probe_work, work);
+
+	probe->count = drm_client_probe_connector(probe->connector,
+						  probe->width, probe->height);
+}
+
+/*
+ * Run fill_modes() on all connectors and return the total number of modes.
+ * Detection and EDID reads dominate the time to first frame on multi-output
+ * boards, so the connectors are probed concurrently from worker threads.
+ * The workers run on behalf of the caller, which holds mode_config.mutex
+ * until all of them are done. They get a workqueue of their own: work on
+ * the system queues may itself wait for mode_config.mutex.
+ */
+static unsigned int drm_client_probe_connectors(struct drm_connector **connectors,
+						unsigned int connector_count,
+						unsigned int width,
+						unsigned int height)
+{
+	struct drm_client_probe_work *probes = NULL;
+	struct workqueue_struct *wq = NULL;
+	unsigned int total_modes_count = 0;
+	unsigned int i;
+
+	if (drm_client_parallel_probe && connector_count > 1) {
+		probes = kcalloc(connector_count, sizeof(*probes), GFP_KERNEL);
+		if (probes)
+			wq = alloc_workqueue("drm_probe", WQ_UNBOUND,
+					     connector_count);
+	}
+
+	if (!wq) {
+		kfree(probes);
+		for (i = 0; i < connector_count; i++)
+			total_modes_count += drm_client_probe_connector(connectors[i],
+									width, height);
+		return total_modes_count;
+	}
+
+	for (i = 0; i < connector_count; i++) {
+		INIT_WORK(&probes[i].work, drm_client_probe_work_fn);
+		probes[i].connector = connectors[i];
+		probes[i].width = width;
+		probes[i].height = height;
+		connectors[i]->parallel_probe = true;
+		queue_work(wq, &probes[i].work);
+	}
+
+	for (i = 0; i < connector_count; i++) {
+		flush_work(&probes[i].work);
+		connectors[i]->parallel_probe = false;
+		total_modes_count += probes[i].count;
+	}
+
+	destroy_workqueue(wq);
+	kfree(probes);
+
+	return total_modes_count;
+}
+
 /**
  * drm_client_modeset_probe() - Probe for displays
  * @client: DRM client
@@ -810,8 +903,8 @@ int drm_client_modeset_probe(struct drm_client_dev *client, unsigned int width,
 	mutex_lock(&client->modeset_mutex);
 
 	mutex_lock(&dev->mode_config.mutex);
-	for (i = 0; i < connector_count; i++)
-		total_modes_count += connectors[i]->funcs->fill_modes(connectors[i], width, height);
+	total_modes_count = drm_client_probe_connectors(connectors, connector_count,
+							width, height);
 	if (!total_modes_count)
 		DRM_DEBUG_KMS("No connectors reported connected with modes\n");
 	drm_client_connectors_enabled(connectors, connector_count, enabled);
@@ -1117,6 +1210,10 @@ int drm_client_modeset_commit_locked(struct drm_client_dev *client)
 		ret = drm_client_modeset_commit_legacy(client);
 	mutex_unlock(&client->modeset_mutex);
 
+	if (!ret)
+		drm_boot_timeline_record(dev, DRM_BOOT_FIRST_MODESET,
+					 client->name);
+
 	return ret;
 }
 EXPORT_SYMBOL(drm_client_modeset_commit_locked);
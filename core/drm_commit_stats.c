@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Atomic commit phase statistics.
+ */
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+
+#ifdef __FreeBSD__
+#include <sys/sbuf.h>
+#endif
+
+#include <drm/drm_atomic.h>
+#include <drm/drm_crtc.h>
+#include <drm/drm_device.h>
+#include <drm/drm_print.h>
+#include <drm/drm_vblank.h>
+
+#include "drm_crtc_internal.h"
+
+/**
+ * DOC: commit statistics
+ *
+ * The atomic helpers time each phase of a commit and account it to every CRTC
+ * in the commit, in a log2 histogram of microseconds. Bucket 0 counts phases
+ * that took less than 1us, bucket n those that took less than 2^n us and the
+ * last bucket everything longer.
+ *
+ * A commit submitted while the CRTC vblank interrupt is on targets the next
+ * vblank. If its flip lands on a later one the CRTC missed_frames counter is
+ * bumped.
+ *
+ * On FreeBSD the statistics are exported per CRTC under
+ * dev.drm.commit_stats.<device>_<crtc>, writing 1 to its reset node clears
+ * them. Recording costs a clock read per phase and can be turned off with
+ * dev.drm.commit_stats_enable.
+ */
+
+#define DRM_COMMIT_HIST_BUCKETS	24
+
+struct drm_crtc_commit_stats {
+	struct drm_crtc *crtc;
+	atomic_t hist[DRM_COMMIT_PHASE_COUNT][DRM_COMMIT_HIST_BUCKETS];
+	atomic_t commits;
+	atomic_t missed_frames;
+
+#ifdef __FreeBSD__
+	struct sysctl_ctx_list sysctl_ctx;
+	char sysctl_name[32];
+#endif
+};
+
+static const char *drm_commit_phase_names[DRM_COMMIT_PHASE_COUNT] = {
+	[DRM_COMMIT_PHASE_CHECK] = "check",
+	[DRM_COMMIT_PHASE_SETUP] = "setup_commit",
+	[DRM_COMMIT_PHASE_PREPARE] = "prepare_planes",
+	[DRM_COMMIT_PHASE_FENCES] = "fences",
+	[DRM_COMMIT_PHASE_DEPENDENCIES] = "dependencies",
+	[DRM_COMMIT_PHASE_DISABLES] = "disables",
+	[DRM_COMMIT_PHASE_ENABLES] = "enables",
+	[DRM_COMMIT_PHASE_PLANES] = "planes",
+	[DRM_COMMIT_PHASE_HW_DONE] = "hw_done",
+	[DRM_COMMIT_PHASE_VBLANKS] = "wait_for_vblanks",
+	[DRM_COMMIT_PHASE_CLEANUP] = "cleanup_planes",
+	[DRM_COMMIT_PHASE_TOTAL] = "total",
+};
+
+static bool drm_commit_stats_enable = true;
+#ifdef __FreeBSD__
+MODULE_PARM_DESC(commit_stats_enable, "Record atomic commit phase statistics");
+#endif
+module_param_named(commit_stats_enable, drm_commit_stats_enable, bool, 0600);
+
+#ifdef __FreeBSD__
+static SYSCTL_NODE(_dev_drm, OID_AUTO, commit_stats, CTLFLAG_RW, 0,
+    "Atomic commit statistics");
+#endif
+
+/**
+ * drm_commit_stats_start - start timing a commit phase
+ *
+ * Returns the time stamp to pass to drm_commit_stats_record(), or 0 if
+ * statistics are disabled.
+ */
+ktime_t drm_commit_stats_start(void)
+{
+	if (!READ_ONCE(drm_commit_stats_enable))
+		return 0;
+
+	return ktime_get();
+}
+
+/**
+ * drm_commit_stats_record - account a commit phase
+ * @state: atomic state of the commit
+ * @phase: phase which just finished
+ * @start: time stamp returned by drm_commit_stats_start()
+ *
+ * Adds the time since @start to the @phase histogram of all CRTCs in @state.
+ * Only the CRTC pointers of @state are used, so this may be called after
+ * drm_atomic_helper_commit_hw_done().
+ */
+void drm_commit_stats_record(struct drm_atomic_state *state,
+			     enum drm_commit_phase phase, ktime_t start)
+{
+	struct drm_crtc_commit_stats *stats;
+	struct drm_crtc *crtc;
+	s64 us;
+	int i, bucket;
+
+	if (start == 0)
+		return;
+
+	us = ktime_us_delta(ktime_get(), start);
+	if (us <= 0)
+		bucket = 0;
+	else
+		bucket = min_t(int, ilog2(us) + 1, DRM_COMMIT_HIST_BUCKETS - 1);
+
+	for (i = 0; i < state->dev->mode_config.num_crtc; i++) {
+		crtc = state->crtcs[i].ptr;
+		if (!crtc || !crtc->commit_stats)
+			continue;
+
+		stats = crtc->commit_stats;
+		atomic_inc(&stats->hist[phase][bucket]);
+		if (phase == DRM_COMMIT_PHASE_TOTAL)
+			atomic_inc(&stats->commits);
+	}
+}
+
+/**
+ * drm_commit_stats_set_targets - note the vblank each CRTC commit aims for
+ * @state: atomic state being committed
+ *
+ * Called when the commit is submitted. CRTCs that stay active and have their
+ * vblank interrupt on target the next vblank, all others are not checked for
+ * missed frames since their vblank counter may be stale.
+ */
+void drm_commit_stats_set_targets(struct drm_atomic_state *state)
+{
+	struct drm_device *dev = state->dev;
+	struct drm_crtc_state *old_crtc_state, *new_crtc_state;
+	struct drm_crtc *crtc;
+	int i;
+
+	if (!READ_ONCE(drm_commit_stats_enable) || !drm_dev_has_vblank(dev))
+		return;
+
+	for_each_oldnew_crtc_in_state(state, crtc, old_crtc_state,
+				      new_crtc_state, i) {
+		state->crtcs[i].target_vblank_count = 0;
+		if (!old_crtc_state->active || !new_crtc_state->active ||
+		    drm_atomic_crtc_needs_modeset(new_crtc_state))
+			continue;
+		if (!READ_ONCE(dev->vblank[drm_crtc_index(crtc)].enabled))
+			continue;
+
+		state->crtcs[i].target_vblank_count =
+			drm_crtc_vblank_count(crtc) + 1;
+	}
+}
+
+/**
+ * drm_commit_stats_flip_landed - check a flip against its target vblank
+ * @state: atomic state of the commit
+ * @i: index of the CRTC in @state
+ *
+ * Called once the flip on the CRTC is known to have happened.
+ */
+void drm_commit_stats_flip_landed(struct drm_atomic_state *state, int i)
+{
+	struct drm_crtc *crtc = state->crtcs[i].ptr;
+	u64 target = state->crtcs[i].target_vblank_count;
+
+	if (target == 0 || !crtc->commit_stats)
+		return;
+
+	if (drm_crtc_vblank_count(crtc) > target)
+		atomic_inc(&crtc->commit_stats->missed_frames);
+}
+
+#ifdef __FreeBSD__
+static int
+drm_commit_stats_hist_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_crtc_commit_stats *stats = arg1;
+	struct sbuf sb;
+	u_int count;
+	int error, phase, bucket;
+
+	error = sysctl_wire_old_buffer(req, 0);
+	if (error != 0)
+		return (error);
+
+	sbuf_new_for_sysctl(&sb, NULL, 256, req);
+	for (phase = 0; phase < DRM_COMMIT_PHASE_COUNT; phase++) {
+		sbuf_printf(&sb, "\n%-16s", drm_commit_phase_names[phase]);
+		for (bucket = 0; bucket < DRM_COMMIT_HIST_BUCKETS; bucket++) {
+			count = atomic_read(&stats->hist[phase][bucket]);
+			if (count == 0)
+				continue;
+			if (bucket == DRM_COMMIT_HIST_BUCKETS - 1)
+				sbuf_printf(&sb, " >=%uus:%u",
+				    1u << (bucket - 1), count);
+			else
+				sbuf_printf(&sb, " <%uus:%u", 1u << bucket,
+				    count);
+		}
+	}
+	error = sbuf_finish(&sb);
+	sbuf_delete(&sb);
+
+	return (error);
+}
+
+static int
+drm_commit_stats_count_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_crtc_commit_stats *stats = arg1;
+	u_int count;
+
+	if (arg2 == 0)
+		count = atomic_read(&stats->commits);
+	else
+		count = atomic_read(&stats->missed_frames);
+
+	return (sysctl_handle_int(oidp, &count, 0, req));
+}
+
+static int
+drm_commit_stats_reset_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_crtc_commit_stats *stats = arg1;
+	int error, phase, bucket, val;
+
+	val = 0;
+	error = sysctl_handle_int(oidp, &val, 0, req);
+	if (error != 0 || req->newptr == NULL || val == 0)
+		return (error);
+
+	for (phase = 0; phase < DRM_COMMIT_PHASE_COUNT; phase++)
+		for (bucket = 0; bucket < DRM_COMMIT_HIST_BUCKETS; bucket++)
+			atomic_set(&stats->hist[phase][bucket], 0);
+	atomic_set(&stats->commits, 0);
+	atomic_set(&stats->missed_frames, 0);
+
+	return (0);
+}
+
+static void
+drm_commit_stats_sysctl_init(struct drm_crtc_commit_stats *stats)
+{
+	struct drm_crtc *crtc = stats->crtc;
+	struct sysctl_oid *node;
+
+	snprintf(stats->sysctl_name, sizeof(stats->sysctl_name), "%s_%s",
+	    device_get_nameunit(crtc->dev->dev), crtc->name);
+
+	sysctl_ctx_init(&stats->sysctl_ctx);
+	node = SYSCTL_ADD_NODE(&stats->sysctl_ctx,
+	    SYSCTL_STATIC_CHILDREN(_dev_drm_commit_stats), OID_AUTO,
+	    stats->sysctl_name, CTLFLAG_RD, NULL, "Crtc commit statistics");
+	if (node == NULL)
+		return;
+
+	SYSCTL_ADD_PROC(&stats->sysctl_ctx, SYSCTL_CHILDREN(node), OID_AUTO,
+	    "phases", CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_MPSAFE,
+	    stats, 0, drm_commit_stats_hist_sysctl, "A",
+	    "Log2 histograms of commit phase latencies");
+	SYSCTL_ADD_PROC(&stats->sysctl_ctx, SYSCTL_CHILDREN(node), OID_AUTO,
+	    "commits", CTLTYPE_UINT | CTLFLAG_RD | CTLFLAG_MPSAFE,
+	    stats, 0, drm_commit_stats_count_sysctl, "IU",
+	    "Number of commits");
+	SYSCTL_ADD_PROC(&stats->sysctl_ctx, SYSCTL_CHILDREN(node), OID_AUTO,
+	    "missed_frames", CTLTYPE_UINT | CTLFLAG_RD | CTLFLAG_MPSAFE,
+	    stats, 1, drm_commit_stats_count_sysctl, "IU",
+	    "Number of flips that landed after their target vblank");
+	SYSCTL_ADD_PROC(&stats->sysctl_ctx, SYSCTL_CHILDREN(node), OID_AUTO,
+	    "reset", CTLTYPE_INT | CTLFLAG_RW | CTLFLAG_MPSAFE,
+	    stats, 0, drm_commit_stats_reset_sysctl, "I",
+	    "Write 1 to clear the statistics");
+}
+#endif
+
+int drm_crtc_commit_stats_init(struct drm_crtc *crtc)
+{
+	struct drm_crtc_commit_stats *stats;
+
+	stats = kzalloc(sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+
+	stats->crtc = crtc;
+	crtc->commit_stats = stats;
+
+#ifdef __FreeBSD__
+	drm_commit_stats_sysctl_init(stats);
+#endif
+
+	return 0;
+}
+
+void drm_crtc_commit_stats_fini(struct drm_crtc *crtc)
+{
+	struct drm_crtc_commit_stats *stats = crtc->commit_stats;
+
+	if (!stats)
+		return;
+
+#ifdef __FreeBSD__
+	sysctl_ctx_free(&stats->sysctl_ctx);
+#endif
+	crtc->commit_stats = NULL;
+	kfree(stats);
+}
@@ -34,11 +34,19 @@
 #include <drm/drm_file.h>
 #include <drm/drm_sysfs.h>
 
+#include <linux/moduleparam.h>
 #include <linux/uaccess.h>
 
 #include "drm_crtc_internal.h"
 #include "drm_internal.h"
 
+static bool drm_async_getconnector = false;
+module_param_named(async_getconnector, drm_async_getconnector, bool, 0600);
+#ifdef __FreeBSD__
+MODULE_PARM_DESC(async_getconnector,
+    "Answer GETCONNECTOR from the last probe and reprobe in the background");
+#endif
+
 /**
  * DOC: overview
  *
@@ -206,6 +214,188 @@ void drm_connector_free_work_fn(struct work_struct *work)
 	}
 }
 
+static struct drm_encoder *drm_connector_get_encoder(struct drm_connector *connector)
+{
+	/* For atomic drivers only state objects are synchronously updated and
+	 * protected by modeset locks, so check those first. */
+	if (connector->state)
+		return connector->state->best_encoder;
+	return connector->encoder;
+}
+
+static bool drm_connector_probe_changed(struct drm_connector *connector,
+					struct drm_display_mode *modes,
+					int count)
+{
+	int i;
+
+	if (!connector->probe_cached ||
+	    connector->probe_status != connector->status ||
+	    connector->probe_mode_count != count)
+		return true;
+
+	for (i = 0; i < count; i++)
+		if (!drm_mode_equal(&connector->probe_modes[i], &modes[i]))
+			return true;
+
+	return false;
+}
+
+/**
+ * drm_connector_invalidate_probe_snapshot - drop the cached probe result
+ * @connector: connector
+ *
+ * Called when the connector status changes outside of a full probe, so that
+ * an asynchronous GETCONNECTOR probes synchronously instead of answering with
+ * stale modes.
+ */
+void drm_connector_invalidate_probe_snapshot(struct drm_connector *connector)
+{
+	struct drm_display_mode *old_modes;
+
+	mutex_lock(&connector->probe_lock);
+	old_modes = connector->probe_modes;
+	connector->probe_modes = NULL;
+	connector->probe_mode_count = 0;
+	connector->probe_cached = false;
+	mutex_unlock(&connector->probe_lock);
+
+	kfree(old_modes);
+}
+EXPORT_SYMBOL(drm_connector_invalidate_probe_snapshot);
+
+/**
+ * drm_connector_update_probe_snapshot - publish the result of a probe
+ * @connector: connector
+ *
+ * Bumps the PROBE_GENERATION property and, when GETCONNECTOR is answered
+ * asynchronously, caches the status, modes, encoder and property values so
+ * that GETCONNECTOR can be served without &drm_mode_config.mutex or
+ * &drm_mode_config.connection_mutex. Called at the end of every
+ * &drm_connector_funcs.fill_modes implementation, with
+ * &drm_mode_config.mutex held and no modeset locks.
+ */
+void drm_connector_update_probe_snapshot(struct drm_connector *connector)
+{
+	struct drm_device *dev = connector->dev;
+	struct drm_property *props[DRM_OBJECT_MAX_PROPERTY];
+	uint64_t values[DRM_OBJECT_MAX_PROPERTY];
+	struct drm_display_mode *mode, *modes, *old_modes;
+	struct drm_encoder *encoder;
+	uint32_t encoder_id;
+	int count = 0, nprops;
+	u64 generation;
+
+	/* Held by the caller, which may be waiting on parallel probe workers. */
+	WARN_ON(!mutex_is_locked(&dev->mode_config.mutex));
+
+	mutex_lock(&connector->probe_lock);
+	generation = ++connector->probe_generation;
+	mutex_unlock(&connector->probe_lock);
+
+	drm_object_property_set_value(&connector->base,
+				      dev->mode_config.probe_generation_property,
+				      generation);
+
+	/* Nobody answers from the snapshot, do not pay for the copy. */
+	if (!READ_ONCE(drm_async_getconnector)) {
+		if (connector->probe_cached)
+			drm_connector_invalidate_probe_snapshot(connector);
+		return;
+	}
+
+	list_for_each_entry(mode, &connector->modes, head)
+		count++;
+
+	modes = kmalloc_array(max(count, 1), sizeof(*modes), GFP_KERNEL);
+	if (!modes) {
+		drm_connector_invalidate_probe_snapshot(connector);
+		return;
+	}
+
+	count = 0;
+	list_for_each_entry(mode, &connector->modes, head)
+		drm_mode_copy(&modes[count++], mode);
+
+	drm_modeset_lock(&dev->mode_config.connection_mutex, NULL);
+	encoder = drm_connector_get_encoder(connector);
+	encoder_id = encoder ? encoder->base.id : 0;
+	nprops = drm_mode_object_read_properties(&connector->base, props,
+						 values);
+	drm_modeset_unlock(&dev->mode_config.connection_mutex);
+
+	if (nprops < 0) {
+		kfree(modes);
+		drm_connector_invalidate_probe_snapshot(connector);
+		return;
+	}
+
+	mutex_lock(&connector->probe_lock);
+	if (drm_connector_probe_changed(connector, modes, count))
+		connector->probe_changed = true;
+	old_modes = connector->probe_modes;
+	connector->probe_modes = modes;
+	connector->probe_mode_count = count;
+	connector->probe_status = connector->status;
+	connector->probe_width_mm = connector->display_info.width_mm;
+	connector->probe_height_mm = connector->display_info.height_mm;
+	connector->probe_subpixel = connector->display_info.subpixel_order;
+	connector->probe_encoder_id = encoder_id;
+	memcpy(connector->probe_props, props, nprops * sizeof(props[0]));
+	memcpy(connector->probe_prop_values, values,
+	       nprops * sizeof(values[0]));
+	connector->probe_prop_count = nprops;
+	connector->probe_cached = true;
+	mutex_unlock(&connector->probe_lock);
+
+	kfree(old_modes);
+}
+EXPORT_SYMBOL(drm_connector_update_probe_snapshot);
+
+static void drm_connector_probe_work(struct work_struct *work)
+{
+	struct drm_connector *connector =
+		container_of(work, struct drm_connector, probe_work);
+	struct drm_device *dev = connector->dev;
+	bool changed;
+
+	mutex_lock(&dev->mode_config.mutex);
+	mutex_lock(&connector->probe_lock);
+	connector->probe_changed = false;
+	mutex_unlock(&connector->probe_lock);
+
+	connector->funcs->fill_modes(connector,
+				     dev->mode_config.max_width,
+				     dev->mode_config.max_height);
+
+	mutex_lock(&connector->probe_lock);
+	changed = connector->probe_changed;
+	mutex_unlock(&connector->probe_lock);
+	mutex_unlock(&dev->mode_config.mutex);
+
+	/*
+	 * Userspace was handed the previous snapshot, tell it to come back
+	 * for the new one. An unchanged reprobe stays silent, otherwise the
+	 * resulting GETCONNECTOR would trigger the next reprobe forever.
+	 */
+	if (changed)
+		drm_sysfs_hotplug_event(dev);
+
+	drm_connector_put(connector);
+}
+
+static void drm_connector_schedule_probe(struct drm_connector *connector)
+{
+	mutex_lock(&connector->mutex);
+	if (connector->registration_state == DRM_CONNECTOR_REGISTERED) {
+		/* The work item owns a reference until it has run. */
+		drm_connector_get(connector);
+		if (!queue_work(system_long_wq, &connector->probe_work))
+			drm_connector_put(connector);
+	}
+	mutex_unlock(&connector->mutex);
+}
+
 /**
  * drm_connector_init - Init a preallocated connector
  * @dev: DRM device
@@ -273,6 +463,8 @@ int drm_connector_init(struct drm_device *dev,
 	INIT_LIST_HEAD(&connector->probed_modes);
 	INIT_LIST_HEAD(&connector->modes);
 	mutex_init(&connector->mutex);
+	mutex_init(&connector->probe_lock);
+	INIT_WORK(&connector->probe_work, drm_connector_probe_work);
 	connector->edid_blob_ptr = NULL;
 	connector->tile_blob_ptr = NULL;
 	connector->status = connector_status_unknown;
@@ -305,6 +497,9 @@ int drm_connector_init(struct drm_device *dev,
 	drm_object_attach_property(&connector->base,
 				   config->tile_property,
 				   0);
+	drm_object_attach_property(&connector->base,
+				   config->probe_generation_property,
+				   0);
 
 	if (drm_core_check_feature(dev, DRIVER_ATOMIC)) {
 		drm_object_attach_property(&connector->base, config->prop_crtc_id, 0);
@@ -465,6 +660,21 @@ void drm_connector_cleanup(struct drm_connector *connector)
 	list_for_each_entry_safe(mode, t, &connector->modes, head)
 		drm_mode_remove(connector, mode);
 
+	/*
+	 * Identical EDID/PATH/TILE blobs are shared between connectors, so
+	 * each connector has to drop its own reference rather than leave it
+	 * to drm_mode_config_cleanup().
+	 */
+	drm_property_blob_put(connector->edid_blob_ptr);
+	connector->edid_blob_ptr = NULL;
+	drm_property_blob_put(connector->path_blob_ptr);
+	connector->path_blob_ptr = NULL;
+	drm_property_blob_put(connector->tile_blob_ptr);
+	connector->tile_blob_ptr = NULL;
+
+	kfree(connector->probe_modes);
+	connector->probe_modes = NULL;
+
 	ida_simple_remove(&drm_connector_enum_list[connector->connector_type].ida,
 			  connector->connector_type_id);
 
@@ -485,6 +695,7 @@ void drm_connector_cleanup(struct drm_connector *connector)
 		connector->funcs->atomic_destroy_state(connector,
 						       connector->state);
 
+	mutex_destroy(&connector->probe_lock);
 	mutex_destroy(&connector->mutex);
 
 	memset(connector, 0, sizeof(*connector));
@@ -569,6 +780,10 @@ void drm_connector_unregister(struct drm_connector *connector)
 
 	connector->registration_state = DRM_CONNECTOR_UNREGISTERED;
 	mutex_unlock(&connector->mutex);
+
+	/* No new reprobes can be queued now, drop a pending one. */
+	if (cancel_work_sync(&connector->probe_work))
+		drm_connector_put(connector);
 }
 EXPORT_SYMBOL(drm_connector_unregister);
 
@@ -1246,6 +1461,12 @@ int drm_connector_create_standard_properties(struct drm_device *dev)
 		return -ENOMEM;
 	dev->mode_config.non_desktop_property = prop;
 
+	prop = drm_property_create_range(dev, DRM_MODE_PROP_IMMUTABLE,
+					 "PROBE_GENERATION", 0, U64_MAX);
+	if (!prop)
+		return -ENOMEM;
+	dev->mode_config.probe_generation_property = prop;
+
 	prop = drm_property_create(dev, DRM_MODE_PROP_BLOB,
 				   "HDR_OUTPUT_METADATA", 0);
 	if (!prop)
@@ -2199,15 +2420,6 @@ int drm_connector_property_set_ioctl(struct drm_device *dev,
 	return drm_mode_obj_set_property_ioctl(dev, &obj_set_prop, file_priv);
 }
 
-static struct drm_encoder *drm_connector_get_encoder(struct drm_connector *connector)
-{
-	/* For atomic drivers only state objects are synchronously updated and
-	 * protected by modeset locks, so check those first. */
-	if (connector->state)
-		return connector->state->best_encoder;
-	return connector->encoder;
-}
-
 static bool
 drm_mode_expose_to_userspace(const struct drm_display_mode *mode,
 			     const struct list_head *export_list,
@@ -2240,6 +2452,118 @@ drm_mode_expose_to_userspace(const struct drm_display_mode *mode,
 	return true;
 }
 
+/*
+ * Second half of GETCONNECTOR's two-call protocol: the first call only
+ * learns @mode_count, the second passes a large enough array to be filled
+ * from @export_list.
+ */
+static int drm_mode_getconnector_copy_modes(struct drm_mode_get_connector *out_resp,
+					    struct list_head *export_list,
+					    int mode_count,
+					    struct drm_file *file_priv)
+{
+	struct drm_mode_modeinfo u_mode;
+	struct drm_mode_modeinfo __user *mode_ptr;
+	struct drm_display_mode *mode;
+	int copied = 0;
+
+	memset(&u_mode, 0, sizeof(struct drm_mode_modeinfo));
+
+	if ((out_resp->count_modes >= mode_count) && mode_count) {
+		mode_ptr = (struct drm_mode_modeinfo __user *)(unsigned long)out_resp->modes_ptr;
+		list_for_each_entry(mode, export_list, export_head) {
+			drm_mode_convert_to_umode(&u_mode, mode);
+			/*
+			 * Reset aspect ratio flags of user-mode, if modes with
+			 * aspect-ratio are not supported.
+			 */
+			if (!file_priv->aspect_ratio_allowed)
+				u_mode.flags &= ~DRM_MODE_FLAG_PIC_AR_MASK;
+			if (copy_to_user(mode_ptr + copied,
+					 &u_mode, sizeof(u_mode)))
+				return -EFAULT;
+			copied++;
+		}
+	}
+	out_resp->count_modes = mode_count;
+
+	return 0;
+}
+
+/*
+ * Answer GETCONNECTOR from the snapshot of the last completed probe, without
+ * touching &drm_mode_config.mutex or &drm_mode_config.connection_mutex, and
+ * queue a reprobe when userspace asks for fresh modes. Returns -EAGAIN if
+ * there is no snapshot to answer from.
+ */
+static int drm_mode_getconnector_async(struct drm_connector *connector,
+				       struct drm_mode_get_connector *out_resp,
+				       struct drm_file *file_priv)
+{
+	uint32_t __user *prop_ptr;
+	uint64_t __user *prop_values;
+	struct drm_display_mode *mode;
+	struct drm_property *prop;
+	bool reprobe = out_resp->count_modes == 0;
+	int mode_count = 0, prop_count = 0;
+	int i, ret;
+	LIST_HEAD(export_list);
+
+	mutex_lock(&connector->probe_lock);
+	if (!connector->probe_cached) {
+		/* No usable snapshot, the caller has to probe. */
+		mutex_unlock(&connector->probe_lock);
+		return -EAGAIN;
+	}
+
+	out_resp->mm_width = connector->probe_width_mm;
+	out_resp->mm_height = connector->probe_height_mm;
+	out_resp->subpixel = connector->probe_subpixel;
+	out_resp->connection = connector->probe_status;
+	out_resp->encoder_id = connector->probe_encoder_id;
+
+	for (i = 0; i < connector->probe_mode_count; i++) {
+		mode = &connector->probe_modes[i];
+		if (drm_mode_expose_to_userspace(mode, &export_list,
+						 file_priv)) {
+			list_add_tail(&mode->export_head, &export_list);
+			mode_count++;
+		}
+	}
+
+	ret = drm_mode_getconnector_copy_modes(out_resp, &export_list,
+					       mode_count, file_priv);
+	if (ret)
+		goto unlock;
+
+	prop_ptr = (uint32_t __user *)(unsigned long)out_resp->props_ptr;
+	prop_values = (uint64_t __user *)(unsigned long)out_resp->prop_values_ptr;
+	for (i = 0; i < connector->probe_prop_count; i++) {
+		prop = connector->probe_props[i];
+		if ((prop->flags & DRM_MODE_PROP_ATOMIC) && !file_priv->atomic)
+			continue;
+
+		if (out_resp->count_props > prop_count) {
+			if (put_user(prop->base.id, prop_ptr + prop_count) ||
+			    put_user(connector->probe_prop_values[i],
+				     prop_values + prop_count)) {
+				ret = -EFAULT;
+				goto unlock;
+			}
+		}
+		prop_count++;
+	}
+	out_resp->count_props = prop_count;
+
+unlock:
+	mutex_unlock(&connector->probe_lock);
+
+	if (ret == 0 && reprobe)
+		drm_connector_schedule_probe(connector);
+
+	return ret;
+}
+
 int drm_mode_getconnector(struct drm_device *dev, void *data,
 			  struct drm_file *file_priv)
 {
@@ -2251,16 +2575,12 @@ int drm_mode_getconnector(struct drm_device *dev, void *data,
 	int encoders_count = 0;
 	int ret = 0;
 	int copied = 0;
-	struct drm_mode_modeinfo u_mode;
-	struct drm_mode_modeinfo __user *mode_ptr;
 	uint32_t __user *encoder_ptr;
 	LIST_HEAD(export_list);
 
 	if (!drm_core_check_feature(dev, DRIVER_MODESET))
 		return -EOPNOTSUPP;
 
-	memset(&u_mode, 0, sizeof(struct drm_mode_modeinfo));
-
 	connector = drm_connector_lookup(dev, file_priv, out_resp->connector_id);
 	if (!connector)
 		return -ENOENT;
@@ -2285,6 +2605,14 @@ int drm_mode_getconnector(struct drm_device *dev, void *data,
 	out_resp->connector_type = connector->connector_type;
 	out_resp->connector_type_id = connector->connector_type_id;
 
+	if (drm_async_getconnector) {
+		ret = drm_mode_getconnector_async(connector, out_resp,
+						  file_priv);
+		if (ret != -EAGAIN)
+			goto out;
+		ret = 0;
+	}
+
 	mutex_lock(&dev->mode_config.mutex);
 	if (out_resp->count_modes == 0) {
 		connector->funcs->fill_modes(connector,
@@ -2313,29 +2641,11 @@ int drm_mode_getconnector(struct drm_device *dev, void *data,
 	 * space, the export_list gets filled, to find the no.of modes. In the
 	 * 2nd time, the user modes are filled, one by one from the export_list.
 	 */
-	if ((out_resp->count_modes >= mode_count) && mode_count) {
-		copied = 0;
-		mode_ptr = (struct drm_mode_modeinfo __user *)(unsigned long)out_resp->modes_ptr;
-		list_for_each_entry(mode, &export_list, export_head) {
-			drm_mode_convert_to_umode(&u_mode, mode);
-			/*
-			 * Reset aspect ratio flags of user-mode, if modes with
-			 * aspect-ratio are not supported.
-			 */
-			if (!file_priv->aspect_ratio_allowed)
-				u_mode.flags &= ~DRM_MODE_FLAG_PIC_AR_MASK;
-			if (copy_to_user(mode_ptr + copied,
-					 &u_mode, sizeof(u_mode))) {
-				ret = -EFAULT;
-				mutex_unlock(&dev->mode_config.mutex);
-
-				goto out;
-			}
-			copied++;
-		}
-	}
-	out_resp->count_modes = mode_count;
+	ret = drm_mode_getconnector_copy_modes(out_resp, &export_list,
+					       mode_count, file_priv);
 	mutex_unlock(&dev->mode_config.mutex);
+	if (ret)
+		goto out;
 
 	drm_modeset_lock(&dev->mode_config.connection_mutex, NULL);
 	encoder = drm_connector_get_encoder(connector);
@@ -292,6 +292,13 @@ int drm_crtc_init_with_planes(struct drm_device *dev, struct drm_crtc *crtc,
 		return ret;
 	}
 
+	ret = drm_crtc_commit_stats_init(crtc);
+	if (ret) {
+		drm_crtc_crc_fini(crtc);
+		drm_mode_object_unregister(dev, &crtc->base);
+		return ret;
+	}
+
 	if (drm_core_check_feature(dev, DRIVER_ATOMIC)) {
 		drm_object_attach_property(&crtc->base, config->prop_active, 0);
 		drm_object_attach_property(&crtc->base, config->prop_mode_id, 0);
@@ -323,6 +330,7 @@ void drm_crtc_cleanup(struct drm_crtc *crtc)
 	 */
 
 	drm_crtc_crc_fini(crtc);
+	drm_crtc_commit_stats_fini(crtc);
 
 	kfree(crtc->gamma_store);
 	crtc->gamma_store = NULL;
@@ -31,6 +31,7 @@
  * and are not exported to drivers.
  */
 
+#include <linux/ktime.h>
 #include <linux/types.h>
 
 enum drm_color_encoding;
@@ -72,6 +73,31 @@ int drm_crtc_force_disable(struct drm_crtc *crtc);
 
 struct dma_fence *drm_crtc_create_fence(struct drm_crtc *crtc);
 
+/* drm_commit_stats.c */
+enum drm_commit_phase {
+	DRM_COMMIT_PHASE_CHECK,
+	DRM_COMMIT_PHASE_SETUP,
+	DRM_COMMIT_PHASE_PREPARE,
+	DRM_COMMIT_PHASE_FENCES,
+	DRM_COMMIT_PHASE_DEPENDENCIES,
+	DRM_COMMIT_PHASE_DISABLES,
+	DRM_COMMIT_PHASE_ENABLES,
+	DRM_COMMIT_PHASE_PLANES,
+	DRM_COMMIT_PHASE_HW_DONE,
+	DRM_COMMIT_PHASE_VBLANKS,
+	DRM_COMMIT_PHASE_CLEANUP,
+	DRM_COMMIT_PHASE_TOTAL,
+	DRM_COMMIT_PHASE_COUNT
+};
+
+int drm_crtc_commit_stats_init(struct drm_crtc *crtc);
+void drm_crtc_commit_stats_fini(struct drm_crtc *crtc);
+ktime_t drm_commit_stats_start(void);
+void drm_commit_stats_record(struct drm_atomic_state *state,
+			     enum drm_commit_phase phase, ktime_t start);
+void drm_commit_stats_set_targets(struct drm_atomic_state *state);
+void drm_commit_stats_flip_landed(struct drm_atomic_state *state, int i);
+
 /* IOCTLs */
 int drm_mode_getcrtc(struct drm_device *dev,
 		     void *data, struct drm_file *file_priv);
@@ -153,6 +179,9 @@ int drm_mode_object_get_properties(struct drm_mode_object *obj, bool atomic,
 				   uint32_t __user *prop_ptr,
 				   uint64_t __user *prop_values,
 				   uint32_t *arg_count_props);
+int drm_mode_object_read_properties(struct drm_mode_object *obj,
+				    struct drm_property **props,
+				    uint64_t *values);
 struct drm_property *drm_mode_obj_find_prop_id(struct drm_mode_object *obj,
 					       uint32_t prop_id);
 
@@ -25,8 +25,10 @@
 
 #include <drm/drm_device.h>
 #include <drm/drm_drv.h>
+#include <drm/drm_fourcc.h>
 #include <drm/drm_gem.h>
 #include <drm/drm_mode.h>
+#include <drm/drm_mode_config.h>
 
 #include "drm_crtc_internal.h"
 
@@ -94,6 +96,84 @@ int drm_mode_create_dumb(struct drm_device *dev,
 	return dev->driver->dumb_create(file_priv, dev, args);
 }
 
+/**
+ * drm_mode_buffer_align - alignment of a scanout buffer
+ * @dev: DRM device
+ * @format: fourcc of the buffer
+ * @type: type of the planes scanning it out
+ * @pitch_align: returns the pitch alignment in bytes
+ * @base_align: returns the base address alignment in bytes, 0 if none
+ *
+ * Combines &drm_mode_config.pitch_align, &drm_mode_config.base_align and
+ * the &drm_mode_config_funcs.buffer_align hook of the driver.
+ */
+void drm_mode_buffer_align(struct drm_device *dev, u32 format,
+			   enum drm_plane_type type, u32 *pitch_align,
+			   u32 *base_align)
+{
+	const struct drm_mode_config *config = &dev->mode_config;
+
+	*pitch_align = config->pitch_align ?: DRM_DEFAULT_PITCH_ALIGN;
+	*base_align = config->base_align;
+	if (config->funcs && config->funcs->buffer_align)
+		config->funcs->buffer_align(dev, format, type, pitch_align,
+					    base_align);
+	if (*pitch_align == 0)
+		*pitch_align = 1;
+}
+EXPORT_SYMBOL(drm_mode_buffer_align);
+
+/**
+ * drm_mode_buffer_pitch - pitch of a scanout buffer
+ * @dev: DRM device
+ * @format: fourcc of the buffer
+ * @type: type of the planes scanning it out
+ * @width: width in pixels
+ *
+ * Returns the pitch in bytes of the first plane of a @width pixels wide
+ * buffer, rounded up to the alignment returned by drm_mode_buffer_align(),
+ * or 0 if @format is unknown.
+ */
+u32 drm_mode_buffer_pitch(struct drm_device *dev, u32 format,
+			  enum drm_plane_type type, u32 width)
+{
+	const struct drm_format_info *info;
+	u32 pitch_align, base_align;
+
+	info = drm_format_info(format);
+	if (!info)
+		return 0;
+
+	drm_mode_buffer_align(dev, format, type, &pitch_align, &base_align);
+
+	return roundup((u32)drm_format_info_min_pitch(info, 0, width),
+		       pitch_align);
+}
+EXPORT_SYMBOL(drm_mode_buffer_pitch);
+
+/**
+ * drm_mode_dumb_pitch - pitch of a dumb buffer
+ * @dev: DRM device
+ * @width: width in pixels
+ * @bpp: bits per pixel
+ *
+ * Dumb buffers carry no format, so this assumes the legacy format for @bpp
+ * scanned out by a primary plane. For use by &drm_driver.dumb_create
+ * implementations.
+ */
+u32 drm_mode_dumb_pitch(struct drm_device *dev, u32 width, u32 bpp)
+{
+	u32 pitch_align, base_align;
+	u32 format;
+
+	format = drm_mode_legacy_fb_format(bpp, bpp == 32 ? 24 : bpp);
+	drm_mode_buffer_align(dev, format, DRM_PLANE_TYPE_PRIMARY,
+			      &pitch_align, &base_align);
+
+	return roundup(DIV_ROUND_UP(width * bpp, 8), pitch_align);
+}
+EXPORT_SYMBOL(drm_mode_dumb_pitch);
+
 int drm_mode_create_dumb_ioctl(struct drm_device *dev,
 			       void *data, struct drm_file *file_priv)
 {
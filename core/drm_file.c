@@ -196,7 +196,7 @@ static void drm_events_release(struct drm_file *file_priv)
 
 	/* Remove unconsumed events */
 	list_for_each_entry_safe(e, et, &file_priv->event_list, link) {
-		atomic_add_int(&file_priv->ev_cnt, -1);
+		atomic_subtract_int(&file_priv->ev_bytes, e->event->length);
 		list_del(&e->link);
 		kfree(e);
 	}
@@ -268,6 +268,13 @@ void drm_file_free(struct drm_file *file)
 
 	WARN_ON(!list_empty(&file->event_list));
 
+#ifdef __FreeBSD__
+	seldrain(&file->event_poll);
+	seldrain(&file->drm_rsel);
+	knlist_destroy(&file->drm_rsel.si_note);
+	mtx_destroy(&file->drm_mtx);
+#endif
+
 	put_pid(file->pid);
 	kfree(file);
 }
@@ -550,7 +557,7 @@ ssize_t drm_read(struct file *filp, char __user *buffer,
 					struct drm_pending_event, link);
 			file_priv->event_space += e->event->length;
 			list_del(&e->link);
-			atomic_add_int(&file_priv->ev_cnt, -1);
+			atomic_subtract_int(&file_priv->ev_bytes, e->event->length);
 		}
 		spin_unlock_irq(&dev->event_lock);
 
@@ -578,7 +585,7 @@ put_back_event:
 				spin_lock_irq(&dev->event_lock);
 				file_priv->event_space -= length;
 				list_add(&e->link, &file_priv->event_list);
-				atomic_add_int(&file_priv->ev_cnt, 1);
+				atomic_add_int(&file_priv->ev_bytes, length);
 
 				mtx_lock(&file_priv->drm_mtx);
 				KNOTE_LOCKED(&file_priv->drm_rsel.si_note, 0);
@@ -665,23 +672,19 @@ drm_fstub_kqdetach(struct knote *kn)
 	knlist_remove(&file_priv->drm_rsel.si_note, kn, 0);
 }
 
+/*
+ * Report the bytes of events ready for drm_read().  New events are
+ * knoted as they are queued, so EV_CLEAR filters fire once per event.
+ */
 static int
 drm_fstub_kqread(struct knote *kn, long hint)
 {
 	struct drm_file *file_priv;
-	struct drm_device *dev;
-	int rv;
 
 	file_priv = kn->kn_hook;
-	dev = file_priv->minor->dev;
-
-	kn->kn_data = file_priv->ev_cnt;
-	if (kn->kn_data)
-		rv = 1;
-	else
-		rv = 0;
+	kn->kn_data = atomic_load_int(&file_priv->ev_bytes);
 
-	return (rv);
+	return (kn->kn_data > 0);
 }
 
 static struct filterops drm_fstub_read_filterops = {
@@ -702,9 +705,8 @@ drm_kqfilter(struct file *filp, struct knote *kn)
 	case EVFILT_READ:
 		kn->kn_fop = &drm_fstub_read_filterops;
 		break;
-	case EVFILT_WRITE:
-		panic("here");
 	default:
+		/* DRM files are never written to, only read. */
 		return(EINVAL);
 	}
 
@@ -861,7 +863,7 @@ void drm_send_event_locked(struct drm_device *dev, struct drm_pending_event *e)
 	list_del(&e->pending_link);
 	list_add_tail(&e->link,
 		      &e->file_priv->event_list);
-	atomic_add_int(&e->file_priv->ev_cnt, 1);
+	atomic_add_int(&e->file_priv->ev_bytes, e->event->length);
 	wake_up_interruptible(&e->file_priv->event_wait);
 #ifdef __FreeBSD__
 	selwakeup(&e->file_priv->event_poll);
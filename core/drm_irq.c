@@ -182,19 +182,18 @@ int drm_irq_uninstall(struct drm_device *dev)
 	 * disabled when uninstalling the irq handler.
 	 */
 	if (dev->num_crtcs) {
-		spin_lock_irqsave(&dev->vbl_lock, irqflags);
 		for (i = 0; i < dev->num_crtcs; i++) {
 			struct drm_vblank_crtc *vblank = &dev->vblank[i];
 
-			if (!vblank->enabled)
-				continue;
+			spin_lock_irqsave(&vblank->lock, irqflags);
+			if (vblank->enabled) {
+				WARN_ON(drm_core_check_feature(dev, DRIVER_MODESET));
 
-			WARN_ON(drm_core_check_feature(dev, DRIVER_MODESET));
-
-			drm_vblank_disable_and_save(dev, i);
-			wake_up(&vblank->queue);
+				drm_vblank_disable_and_save(dev, i);
+				wake_up(&vblank->queue);
+			}
+			spin_unlock_irqrestore(&vblank->lock, irqflags);
 		}
-		spin_unlock_irqrestore(&dev->vbl_lock, irqflags);
 	}
 
 	if (!irq_enabled)
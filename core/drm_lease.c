@@ -0,0 +1,628 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright © 2017 Keith Packard <keithp@keithp.com>
+ *
+ * DRM leases: a master hands a subset of its CRTCs, connectors and planes
+ * to a new file, which is master over just those objects.
+ */
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include <drm/drm_auth.h>
+#include <drm/drm_crtc.h>
+#include <drm/drm_drv.h>
+#include <drm/drm_file.h>
+#include <drm/drm_lease.h>
+#include <drm/drm_print.h>
+
+#include "drm_crtc_internal.h"
+#include "drm_internal.h"
+
+#define drm_for_each_lessee(lessee, lessor) \
+	list_for_each_entry((lessee), &(lessor)->lessees, lessee_list)
+
+/*
+ * The lease IDRs only record which objects are leased, the objects are
+ * still looked up in the device object IDR. Any non-NULL pointer will do.
+ */
+static uint64_t drm_lease_idr_object;
+
+/**
+ * drm_lease_owner - return the top of the lease tree of a master
+ * @master: lessee or owner
+ */
+struct drm_master *drm_lease_owner(struct drm_master *master)
+{
+	while (master->lessor != NULL)
+		master = master->lessor;
+	return master;
+}
+
+static struct drm_master *_drm_find_lessee(struct drm_master *master,
+					   int lessee_id)
+{
+	lockdep_assert_held(&master->dev->mode_config.idr_mutex);
+	return idr_find(&drm_lease_owner(master)->lessee_idr, lessee_id);
+}
+
+static bool _drm_lease_held_master(struct drm_master *master, int id)
+{
+	lockdep_assert_held(&master->dev->mode_config.idr_mutex);
+	if (master->lessor)
+		return idr_find(&master->leases, id) != NULL;
+	return true;
+}
+
+/* Checks whether any lessee of master holds the object */
+static bool _drm_has_leased(struct drm_master *master, int id)
+{
+	struct drm_master *lessee;
+
+	lockdep_assert_held(&master->dev->mode_config.idr_mutex);
+	drm_for_each_lessee(lessee, master)
+		if (_drm_lease_held_master(lessee, id))
+			return true;
+	return false;
+}
+
+/**
+ * _drm_lease_held - check whether a file may use an object
+ * @file_priv: DRM file
+ * @id: mode object id
+ *
+ * Must be called with &drm_mode_config.idr_mutex held.
+ */
+bool _drm_lease_held(struct drm_file *file_priv, int id)
+{
+	if (!file_priv || !file_priv->master)
+		return true;
+
+	return _drm_lease_held_master(file_priv->master, id);
+}
+
+/**
+ * drm_lease_held - check whether a file may use an object
+ * @file_priv: DRM file
+ * @id: mode object id
+ *
+ * Files that are not lessees may use every object.
+ */
+bool drm_lease_held(struct drm_file *file_priv, int id)
+{
+	struct drm_master *master;
+	bool ret;
+
+	if (!file_priv || !file_priv->master || !file_priv->master->lessor)
+		return true;
+
+	master = file_priv->master;
+	mutex_lock(&master->dev->mode_config.idr_mutex);
+	ret = _drm_lease_held_master(master, id);
+	mutex_unlock(&master->dev->mode_config.idr_mutex);
+	return ret;
+}
+
+/**
+ * drm_lease_filter_crtcs - restrict a CRTC mask to the leased CRTCs
+ * @file_priv: DRM file
+ * @crtcs_in: mask of CRTC indices on the device
+ *
+ * Lessees only see their own CRTCs, numbered from zero, so the result is
+ * a mask of indices among the leased CRTCs.
+ */
+uint32_t drm_lease_filter_crtcs(struct drm_file *file_priv, uint32_t crtcs_in)
+{
+	struct drm_master *master;
+	struct drm_device *dev;
+	struct drm_crtc *crtc;
+	int count_in, count_out;
+	uint32_t crtcs_out = 0;
+
+	if (!file_priv || !file_priv->master || !file_priv->master->lessor)
+		return crtcs_in;
+
+	master = file_priv->master;
+	dev = master->dev;
+
+	count_in = count_out = 0;
+	mutex_lock(&dev->mode_config.idr_mutex);
+	list_for_each_entry(crtc, &dev->mode_config.crtc_list, head) {
+		if (_drm_lease_held_master(master, crtc->base.id)) {
+			if (crtcs_in & (1u << count_in))
+				crtcs_out |= 1u << count_out;
+			count_out++;
+		}
+		count_in++;
+	}
+	mutex_unlock(&dev->mode_config.idr_mutex);
+	return crtcs_out;
+}
+
+/*
+ * Create a lessee of lessor holding the objects in leases. The entries
+ * are copied, leases still belongs to the caller.
+ */
+static struct drm_master *drm_lease_create(struct drm_master *lessor,
+					   struct idr *leases)
+{
+	struct drm_device *dev = lessor->dev;
+	struct drm_master *lessee;
+	void *entry;
+	int object;
+	int error;
+	int id;
+
+	DRM_DEBUG_LEASE("lessor %d\n", lessor->lessee_id);
+
+	lessee = drm_master_create(dev);
+	if (!lessee)
+		return ERR_PTR(-ENOMEM);
+
+	mutex_lock(&dev->mode_config.idr_mutex);
+
+	idr_for_each_entry(leases, entry, object) {
+		error = 0;
+		if (!idr_find(&dev->mode_config.object_idr, object))
+			error = -ENOENT;
+		else if (_drm_has_leased(lessor, object))
+			error = -EBUSY;
+		else if (idr_alloc(&lessee->leases, entry, object, object + 1,
+				   GFP_KERNEL) < 0)
+			error = -ENOMEM;
+		if (error) {
+			DRM_DEBUG_LEASE("object %d failed %d\n", object, error);
+			goto out_lessee;
+		}
+	}
+
+	/* Insert the new lessee into the tree */
+	id = idr_alloc(&drm_lease_owner(lessor)->lessee_idr, lessee, 1, 0,
+		       GFP_KERNEL);
+	if (id < 0) {
+		error = id;
+		goto out_lessee;
+	}
+
+	lessee->lessee_id = id;
+	lessee->lessor = drm_master_get(lessor);
+	list_add_tail(&lessee->lessee_list, &lessor->lessees);
+
+	DRM_DEBUG_LEASE("new lessee %d, lessor %d\n", lessee->lessee_id,
+			lessor->lessee_id);
+
+	mutex_unlock(&dev->mode_config.idr_mutex);
+	return lessee;
+
+out_lessee:
+	mutex_unlock(&dev->mode_config.idr_mutex);
+	drm_master_put(&lessee);
+	return ERR_PTR(error);
+}
+
+/**
+ * drm_lease_destroy - unlink a master from its lease tree
+ * @master: master being destroyed
+ */
+void drm_lease_destroy(struct drm_master *master)
+{
+	struct drm_device *dev = master->dev;
+
+	mutex_lock(&dev->mode_config.idr_mutex);
+
+	DRM_DEBUG_LEASE("drm_lease_destroy %d\n", master->lessee_id);
+
+	/* Lessees hold a reference on their lessor */
+	WARN_ON(!list_empty(&master->lessees));
+
+	if (master->lessee_id != 0)
+		idr_remove(&drm_lease_owner(master)->lessee_idr,
+			   master->lessee_id);
+
+	list_del(&master->lessee_list);
+
+	mutex_unlock(&dev->mode_config.idr_mutex);
+
+	if (master->lessor) {
+		/* Tell the master to check the lessee list */
+		drm_sysfs_lease_event(dev);
+		drm_master_put(&master->lessor);
+	}
+}
+
+static void _drm_lease_revoke(struct drm_master *top)
+{
+	struct drm_master *master = top;
+	void *entry;
+	int object;
+
+	lockdep_assert_held(&top->dev->mode_config.idr_mutex);
+
+	/*
+	 * Empty the leases of top and of all the lessees below it, walking
+	 * the tree depth first without recursion.
+	 */
+	for (;;) {
+		DRM_DEBUG_LEASE("revoke leases for %d\n", master->lessee_id);
+
+		idr_for_each_entry(&master->leases, entry, object)
+			idr_remove(&master->leases, object);
+
+		if (!list_empty(&master->lessees)) {
+			master = list_first_entry(&master->lessees,
+						  struct drm_master,
+						  lessee_list);
+		} else {
+			while (master != top &&
+			       master == list_last_entry(&master->lessor->lessees,
+							 struct drm_master,
+							 lessee_list))
+				master = master->lessor;
+
+			if (master == top)
+				break;
+
+			master = list_next_entry(master, lessee_list);
+		}
+	}
+}
+
+/**
+ * drm_lease_revoke - revoke the leases of a master and of all its lessees
+ * @top: master
+ */
+void drm_lease_revoke(struct drm_master *top)
+{
+	mutex_lock(&top->dev->mode_config.idr_mutex);
+	_drm_lease_revoke(top);
+	mutex_unlock(&top->dev->mode_config.idr_mutex);
+}
+
+/* A lease must have at least a CRTC and a connector, and a plane if asked */
+static int validate_lease(struct drm_device *dev, int object_count,
+			  struct drm_mode_object **objects,
+			  bool universal_planes)
+{
+	bool has_crtc = false, has_connector = false, has_plane = false;
+	int o;
+
+	for (o = 0; o < object_count; o++) {
+		switch (objects[o]->type) {
+		case DRM_MODE_OBJECT_CRTC:
+			has_crtc = true;
+			break;
+		case DRM_MODE_OBJECT_CONNECTOR:
+			has_connector = true;
+			break;
+		case DRM_MODE_OBJECT_PLANE:
+			has_plane = true;
+			break;
+		}
+	}
+
+	if (!has_crtc || !has_connector)
+		return -EINVAL;
+	if (universal_planes && !has_plane)
+		return -EINVAL;
+	return 0;
+}
+
+static int fill_object_idr(struct drm_device *dev,
+			   struct drm_file *lessor_priv,
+			   struct idr *leases,
+			   int object_count,
+			   u32 *object_ids)
+{
+	struct drm_mode_object **objects;
+	bool universal_planes = READ_ONCE(lessor_priv->universal_planes);
+	int o;
+	int ret;
+
+	objects = kcalloc(object_count, sizeof(*objects), GFP_KERNEL);
+	if (!objects)
+		return -ENOMEM;
+
+	for (o = 0; o < object_count; o++) {
+		objects[o] = drm_mode_object_find(dev, lessor_priv,
+						  object_ids[o],
+						  DRM_MODE_OBJECT_ANY);
+		if (!objects[o]) {
+			ret = -ENOENT;
+			goto out_free_objects;
+		}
+
+		if (!drm_mode_object_lease_required(objects[o]->type)) {
+			DRM_DEBUG_KMS("invalid object for lease\n");
+			ret = -EINVAL;
+			goto out_free_objects;
+		}
+	}
+
+	ret = validate_lease(dev, object_count, objects, universal_planes);
+	if (ret) {
+		DRM_DEBUG_LEASE("lease validation failed\n");
+		goto out_free_objects;
+	}
+
+	for (o = 0; o < object_count; o++) {
+		struct drm_mode_object *obj = objects[o];
+
+		DRM_DEBUG_LEASE("Adding object %d to lease\n", obj->id);
+		ret = idr_alloc(leases, &drm_lease_idr_object, obj->id,
+				obj->id + 1, GFP_KERNEL);
+		if (ret < 0)
+			goto out_free_objects;
+
+		/*
+		 * Clients without universal planes cannot name the primary
+		 * and cursor planes, they come with their CRTC.
+		 */
+		if (obj->type == DRM_MODE_OBJECT_CRTC && !universal_planes) {
+			struct drm_crtc *crtc = obj_to_crtc(obj);
+
+			ret = idr_alloc(leases, &drm_lease_idr_object,
+					crtc->primary->base.id,
+					crtc->primary->base.id + 1, GFP_KERNEL);
+			if (ret < 0)
+				goto out_free_objects;
+			if (crtc->cursor) {
+				ret = idr_alloc(leases, &drm_lease_idr_object,
+						crtc->cursor->base.id,
+						crtc->cursor->base.id + 1,
+						GFP_KERNEL);
+				if (ret < 0)
+					goto out_free_objects;
+			}
+		}
+	}
+
+	ret = 0;
+out_free_objects:
+	for (o = 0; o < object_count; o++) {
+		if (objects[o])
+			drm_mode_object_put(objects[o]);
+	}
+	kfree(objects);
+	return ret;
+}
+
+int drm_mode_create_lease_ioctl(struct drm_device *dev,
+				void *data, struct drm_file *lessor_priv)
+{
+	struct drm_mode_create_lease *cl = data;
+	struct drm_master *lessor = lessor_priv->master;
+	struct drm_master *lessee;
+	struct file *lessor_file = lessor_priv->filp;
+	struct file *lessee_file;
+	struct drm_file *lessee_priv;
+	struct idr leases;
+	uint32_t *object_ids;
+	uint32_t lessee_id;
+	size_t object_count;
+	int fd = -1;
+	int ret;
+
+	if (!drm_core_check_feature(dev, DRIVER_MODESET))
+		return -EOPNOTSUPP;
+
+	/* Do not allow sub-leases */
+	if (lessor->lessor) {
+		DRM_DEBUG_LEASE("recursive leasing not allowed\n");
+		return -EINVAL;
+	}
+
+	if (cl->object_count == 0) {
+		DRM_DEBUG_LEASE("no objects in lease\n");
+		return -EINVAL;
+	}
+
+	/* Every object can be leased at most once */
+	if (cl->object_count > dev->mode_config.num_crtc +
+	    dev->mode_config.num_connector + dev->mode_config.num_total_plane)
+		return -EINVAL;
+
+	if (cl->flags & ~(O_CLOEXEC | O_NONBLOCK)) {
+		DRM_DEBUG_LEASE("invalid flags\n");
+		return -EINVAL;
+	}
+
+	object_count = cl->object_count;
+	object_ids = kcalloc(object_count, sizeof(*object_ids), GFP_KERNEL);
+	if (!object_ids)
+		return -ENOMEM;
+	if (copy_from_user(object_ids, u64_to_user_ptr(cl->object_ids),
+			   array_size(object_count, sizeof(*object_ids)))) {
+		kfree(object_ids);
+		return -EFAULT;
+	}
+
+	idr_init(&leases);
+
+	ret = fill_object_idr(dev, lessor_priv, &leases, object_count,
+			      object_ids);
+	kfree(object_ids);
+	if (ret) {
+		DRM_DEBUG_LEASE("lease object lookup failed: %i\n", ret);
+		idr_destroy(&leases);
+		return ret;
+	}
+
+#ifdef __linux__
+	fd = get_unused_fd_flags(cl->flags & (O_CLOEXEC | O_NONBLOCK));
+	if (fd < 0) {
+		idr_destroy(&leases);
+		return fd;
+	}
+#endif
+
+	lessee = drm_lease_create(lessor, &leases);
+	idr_destroy(&leases);
+	if (IS_ERR(lessee)) {
+		ret = PTR_ERR(lessee);
+		goto out_fd;
+	}
+	lessee_id = lessee->lessee_id;
+
+	/* Open a new file on the device for the lessee */
+#ifdef __linux__
+	lessee_file = file_clone_open(lessor_file);
+#elif defined(__FreeBSD__)
+	lessee_file = drm_fbsd_file_clone(lessor_file);
+#endif
+	if (IS_ERR(lessee_file)) {
+		ret = PTR_ERR(lessee_file);
+		goto out_lessee;
+	}
+
+	/* Make it master of the leased objects */
+	lessee_priv = lessee_file->private_data;
+	drm_master_put(&lessee_priv->master);
+	lessee_priv->master = lessee;
+	lessee_priv->is_master = 1;
+	lessee_priv->authenticated = 1;
+
+#ifdef __linux__
+	fd_install(fd, lessee_file);
+#elif defined(__FreeBSD__)
+	ret = -finstall(curthread, lessee_file, &fd, cl->flags & O_CLOEXEC,
+			NULL);
+	/* If the file was not installed this closes it, ending the lease. */
+	fdrop(lessee_file, curthread);
+	if (ret)
+		return ret;
+#endif
+
+	DRM_DEBUG_LEASE("Returning fd %d id %d\n", fd, lessee_id);
+	cl->fd = fd;
+	cl->lessee_id = lessee_id;
+	return 0;
+
+out_lessee:
+	drm_master_put(&lessee);
+out_fd:
+#ifdef __linux__
+	put_unused_fd(fd);
+#endif
+	DRM_DEBUG_LEASE("drm_mode_create_lease_ioctl failed: %d\n", ret);
+	return ret;
+}
+
+int drm_mode_list_lessees_ioctl(struct drm_device *dev,
+				void *data, struct drm_file *lessor_priv)
+{
+	struct drm_mode_list_lessees *arg = data;
+	__u32 __user *lessee_ids = u64_to_user_ptr(arg->lessees_ptr);
+	__u32 count_lessees = arg->count_lessees;
+	struct drm_master *lessor = lessor_priv->master, *lessee;
+	int count;
+	int ret = 0;
+
+	if (arg->pad)
+		return -EINVAL;
+
+	if (!drm_core_check_feature(dev, DRIVER_MODESET))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&dev->mode_config.idr_mutex);
+
+	count = 0;
+	drm_for_each_lessee(lessee, lessor) {
+		/* Only list un-revoked leases */
+		if (!idr_is_empty(&lessee->leases)) {
+			if (count_lessees > count) {
+				ret = put_user(lessee->lessee_id,
+					       lessee_ids + count);
+				if (ret)
+					break;
+			}
+			count++;
+		}
+	}
+
+	if (ret == 0)
+		arg->count_lessees = count;
+
+	mutex_unlock(&dev->mode_config.idr_mutex);
+
+	return ret;
+}
+
+/* Return the list of objects the calling file may use */
+int drm_mode_get_lease_ioctl(struct drm_device *dev,
+			     void *data, struct drm_file *lessee_priv)
+{
+	struct drm_mode_get_lease *arg = data;
+	__u32 __user *object_ids = u64_to_user_ptr(arg->objects_ptr);
+	__u32 count_objects = arg->count_objects;
+	struct drm_master *lessee = lessee_priv->master;
+	struct idr *object_idr;
+	void *entry;
+	int object;
+	int count;
+	int ret = 0;
+
+	if (arg->pad)
+		return -EINVAL;
+
+	if (!drm_core_check_feature(dev, DRIVER_MODESET))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&dev->mode_config.idr_mutex);
+
+	if (lessee->lessor == NULL)
+		/* The owner can use all objects */
+		object_idr = &lessee->dev->mode_config.object_idr;
+	else
+		object_idr = &lessee->leases;
+
+	count = 0;
+	idr_for_each_entry(object_idr, entry, object) {
+		if (count_objects > count) {
+			ret = put_user(object, object_ids + count);
+			if (ret)
+				break;
+		}
+		count++;
+	}
+
+	if (ret == 0)
+		arg->count_objects = count;
+
+	mutex_unlock(&dev->mode_config.idr_mutex);
+
+	return ret;
+}
+
+int drm_mode_revoke_lease_ioctl(struct drm_device *dev,
+				void *data, struct drm_file *lessor_priv)
+{
+	struct drm_mode_revoke_lease *arg = data;
+	struct drm_master *lessor = lessor_priv->master;
+	struct drm_master *lessee;
+	int ret = 0;
+
+	DRM_DEBUG_LEASE("revoke lease for %d\n", arg->lessee_id);
+
+	if (!drm_core_check_feature(dev, DRIVER_MODESET))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&dev->mode_config.idr_mutex);
+
+	lessee = _drm_find_lessee(lessor, arg->lessee_id);
+	if (!lessee) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	/* Only the lessor may revoke a lease */
+	if (lessee->lessor != lessor) {
+		ret = -EACCES;
+		goto out;
+	}
+
+	_drm_lease_revoke(lessee);
+out:
+	mutex_unlock(&dev->mode_config.idr_mutex);
+
+	return ret;
+}
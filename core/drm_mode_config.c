@@ -386,6 +386,8 @@ static int drm_mode_create_standard_properties(struct drm_device *dev)
  */
 void drm_mode_config_init(struct drm_device *dev)
 {
+	int i;
+
 	mutex_init(&dev->mode_config.mutex);
 	drm_modeset_lock_init(&dev->mode_config.connection_mutex);
 	mutex_init(&dev->mode_config.idr_mutex);
@@ -397,6 +399,8 @@ void drm_mode_config_init(struct drm_device *dev)
 	INIT_LIST_HEAD(&dev->mode_config.encoder_list);
 	INIT_LIST_HEAD(&dev->mode_config.property_list);
 	INIT_LIST_HEAD(&dev->mode_config.property_blob_list);
+	for (i = 0; i < ARRAY_SIZE(dev->mode_config.property_blob_hash); i++)
+		INIT_HLIST_HEAD(&dev->mode_config.property_blob_hash[i]);
 	INIT_LIST_HEAD(&dev->mode_config.plane_list);
 	INIT_LIST_HEAD(&dev->mode_config.privobj_list);
 	idr_init(&dev->mode_config.object_idr);
@@ -356,6 +356,28 @@ int drm_object_property_get_value(struct drm_mode_object *obj,
 }
 EXPORT_SYMBOL(drm_object_property_get_value);
 
+/*
+ * Read the current value of every property of @obj into @props and @values,
+ * which must have room for DRM_OBJECT_MAX_PROPERTY entries. Returns the number
+ * of properties read or a negative error code. For atomic drivers the caller
+ * must hold the lock protecting the state of @obj.
+ */
+int drm_mode_object_read_properties(struct drm_mode_object *obj,
+				    struct drm_property **props,
+				    uint64_t *values)
+{
+	int i, ret;
+
+	for (i = 0; i < obj->properties->count; i++) {
+		props[i] = obj->properties->properties[i];
+		ret = __drm_object_property_get_value(obj, props[i], &values[i]);
+		if (ret)
+			return ret;
+	}
+
+	return i;
+}
+
 /* helper for getconnector and getproperties ioctls */
 int drm_mode_object_get_properties(struct drm_mode_object *obj, bool atomic,
 				   uint32_t __user *prop_ptr,
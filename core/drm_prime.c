@@ -410,14 +410,80 @@ int drm_gem_dmabuf_mmap(struct dma_buf *dma_buf, struct vm_area_struct *vma)
 {
 	struct drm_gem_object *obj = dma_buf->priv;
 	struct drm_device *dev = obj->dev;
+#ifdef __FreeBSD__
+	int ret;
+#endif
 
 	if (!dev->driver->gem_prime_mmap)
 		return -ENOSYS;
 
+#ifdef __linux__
 	return dev->driver->gem_prime_mmap(obj, vma);
+#elif defined(__FreeBSD__)
+	ret = dev->driver->gem_prime_mmap(obj, vma);
+	if (ret)
+		return ret;
+
+	/* Share one VM object with the DRM node mappings of obj */
+	return drm_fbsd_vma_backing_object(vma);
+#endif
 }
 EXPORT_SYMBOL(drm_gem_dmabuf_mmap);
 
+/**
+ * drm_gem_dmabuf_begin_cpu_access - dma_buf begin_cpu_access_partial
+ *                                   implementation for GEM
+ * @dma_buf: buffer to be accessed
+ * @dir: direction of the preceding device access
+ * @offset: start of the accessed range
+ * @len: length of the accessed range
+ *
+ * Calls &drm_driver.gem_prime_begin_cpu_access, if set. This can be used as
+ * the &dma_buf_ops.begin_cpu_access_partial callback.
+ *
+ * Returns 0 on success or a negative error code on failure.
+ */
+int drm_gem_dmabuf_begin_cpu_access(struct dma_buf *dma_buf,
+				    enum dma_data_direction dir,
+				    unsigned long offset, unsigned long len)
+{
+	struct drm_gem_object *obj = dma_buf->priv;
+	struct drm_device *dev = obj->dev;
+
+	if (!dev->driver->gem_prime_begin_cpu_access)
+		return 0;
+
+	return dev->driver->gem_prime_begin_cpu_access(obj, dir, offset, len);
+}
+EXPORT_SYMBOL(drm_gem_dmabuf_begin_cpu_access);
+
+/**
+ * drm_gem_dmabuf_end_cpu_access - dma_buf end_cpu_access_partial
+ *                                 implementation for GEM
+ * @dma_buf: buffer to be accessed
+ * @dir: direction of the following device access
+ * @offset: start of the accessed range
+ * @len: length of the accessed range
+ *
+ * Calls &drm_driver.gem_prime_end_cpu_access, if set. This can be used as
+ * the &dma_buf_ops.end_cpu_access_partial callback.
+ *
+ * Returns 0 on success or a negative error code on failure.
+ */
+int drm_gem_dmabuf_end_cpu_access(struct dma_buf *dma_buf,
+				  enum dma_data_direction dir,
+				  unsigned long offset, unsigned long len)
+{
+	struct drm_gem_object *obj = dma_buf->priv;
+	struct drm_device *dev = obj->dev;
+
+	if (!dev->driver->gem_prime_end_cpu_access)
+		return 0;
+
+	return dev->driver->gem_prime_end_cpu_access(obj, dir, offset, len);
+}
+EXPORT_SYMBOL(drm_gem_dmabuf_end_cpu_access);
+
 static const struct dma_buf_ops drm_gem_prime_dmabuf_ops =  {
 #ifdef notyet
 	.cache_sgt_mapping = true,
@@ -427,6 +493,8 @@ static const struct dma_buf_ops drm_gem_prime_dmabuf_ops =  {
 	.map_dma_buf = drm_gem_map_dma_buf,
 	.unmap_dma_buf = drm_gem_unmap_dma_buf,
 	.release = drm_gem_dmabuf_release,
+	.begin_cpu_access_partial = drm_gem_dmabuf_begin_cpu_access,
+	.end_cpu_access_partial = drm_gem_dmabuf_end_cpu_access,
 	.mmap = drm_gem_dmabuf_mmap,
 	.vmap = drm_gem_dmabuf_vmap,
 	.vunmap = drm_gem_dmabuf_vunmap,
@@ -54,6 +54,216 @@ MODULE_PARM_DESC(debug, "Enable debug output, where each bit enables a debug cat
 "\t\tBit 8 (0x100) will enable DP messages (displayport code)");
 module_param_named(debug, __drm_debug, int, 0600);
 
+#ifdef __FreeBSD__
+#include <sys/param.h>
+#include <sys/kernel.h>
+#include <sys/malloc.h>
+#include <sys/pcpu.h>
+#include <sys/sbuf.h>
+#include <sys/smp.h>
+#include <sys/sysctl.h>
+#include <sys/systm.h>
+#include <machine/atomic.h>
+
+#include <linux/ktime.h>
+
+/*
+ * Debug flight recorder.
+ *
+ * Debug messages in the categories set in __drm_debug_record are formatted
+ * into a ring owned by the current CPU. Writers reserve a slot with a single
+ * atomic increment and publish it by storing its sequence number, so
+ * recording never takes a lock nor touches the console and barely changes
+ * the timing of the code being debugged. The rings are read back, merged by
+ * time, through dev.drm.debug_log or dumped to the console when a commit
+ * times out.
+ */
+#define DRM_DEBUG_RING_ENTRIES	256	/* per CPU, power of two */
+#define DRM_DEBUG_RING_MSG_LEN	112
+
+struct drm_debug_entry {
+	u_int seq;		/* 0 while the slot is being written */
+	ktime_t time;
+	void *caller;
+	char msg[DRM_DEBUG_RING_MSG_LEN];
+};
+
+struct drm_debug_ring {
+	u_int head;
+	struct drm_debug_entry entries[DRM_DEBUG_RING_ENTRIES];
+};
+
+unsigned int __drm_debug_record;
+EXPORT_SYMBOL(__drm_debug_record);
+MODULE_PARM_DESC(debug_record, "Record debug output in the per-CPU flight "
+"recorder instead of printing it, same bits as debug");
+module_param_named(debug_record, __drm_debug_record, int, 0600);
+
+static struct drm_debug_ring **drm_debug_rings;
+
+static void drm_debug_record(void *caller, const char *format, va_list args)
+{
+	struct drm_debug_ring *ring;
+	struct drm_debug_entry *e;
+	u_int ticket;
+
+	if (drm_debug_rings == NULL)
+		return;
+
+	/*
+	 * Migrating after reading curcpu only means the message lands in
+	 * another CPU's ring, the slot itself is still reserved atomically.
+	 */
+	ring = drm_debug_rings[curcpu];
+	ticket = atomic_fetchadd_int(&ring->head, 1);
+	e = &ring->entries[ticket & (DRM_DEBUG_RING_ENTRIES - 1)];
+
+	atomic_store_int(&e->seq, 0);
+	atomic_thread_fence_rel();
+	e->time = ktime_get();
+	e->caller = caller;
+	vsnprintf(e->msg, sizeof(e->msg), format, args);
+	/* 0 marks a slot being written, skip it when the ticket wraps. */
+	atomic_store_rel_int(&e->seq, ticket + 1 != 0 ? ticket + 1 : 1);
+}
+
+static int drm_debug_entry_cmp(const void *a, const void *b)
+{
+	const struct drm_debug_entry *ea = a, *eb = b;
+
+	if (ea->time < eb->time)
+		return -1;
+	return ea->time > eb->time;
+}
+
+/* Copy the published entries of all rings, oldest first. */
+static int drm_debug_record_snapshot(struct drm_debug_entry **entriesp)
+{
+	struct drm_debug_entry *entries, *e;
+	u_int seq;
+	int cpu, i, n;
+
+	entries = malloc(sizeof(*entries) * DRM_DEBUG_RING_ENTRIES *
+	    (mp_maxid + 1), M_TEMP, M_WAITOK);
+	n = 0;
+	CPU_FOREACH(cpu) {
+		for (i = 0; i < DRM_DEBUG_RING_ENTRIES; i++) {
+			e = &drm_debug_rings[cpu]->entries[i];
+			seq = atomic_load_acq_int(&e->seq);
+			if (seq == 0)
+				continue;
+			entries[n] = *e;
+			atomic_thread_fence_acq();
+			/* Overwritten while copying, drop it. */
+			if (atomic_load_int(&e->seq) != seq)
+				continue;
+			entries[n].msg[DRM_DEBUG_RING_MSG_LEN - 1] = '\0';
+			n++;
+		}
+	}
+	qsort(entries, n, sizeof(*entries), drm_debug_entry_cmp);
+
+	*entriesp = entries;
+	return n;
+}
+
+static void drm_debug_record_format(struct sbuf *sb)
+{
+	struct drm_debug_entry *entries, *e;
+	size_t len;
+	int i, n;
+
+	n = drm_debug_record_snapshot(&entries);
+	for (i = 0; i < n; i++) {
+		e = &entries[i];
+		len = strlen(e->msg);
+		sbuf_printf(sb, "[%12jd us] %p %s%s",
+		    (intmax_t)ktime_to_us(e->time), e->caller, e->msg,
+		    len == 0 || e->msg[len - 1] != '\n' ? "\n" : "");
+	}
+	free(entries, M_TEMP);
+}
+
+/**
+ * drm_debug_record_dump - print the debug flight recorder to the console
+ *
+ * Called when something has already gone wrong, e.g. a commit timed out,
+ * so that the events leading up to it are not lost. Rate limited to once a
+ * minute.
+ */
+void drm_debug_record_dump(void)
+{
+	static struct timeval last;
+	static const struct timeval interval = { 60, 0 };
+	struct sbuf *sb;
+
+	if (__drm_debug_record == 0 || drm_debug_rings == NULL)
+		return;
+	if (!ratecheck(&last, &interval))
+		return;
+
+	sb = sbuf_new_auto();
+	drm_debug_record_format(sb);
+	sbuf_finish(sb);
+	printf("[" DRM_NAME "] debug flight recorder:\n%s", sbuf_data(sb));
+	sbuf_delete(sb);
+}
+EXPORT_SYMBOL(drm_debug_record_dump);
+
+static int drm_debug_log_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct sbuf sb;
+	int error;
+
+	if (drm_debug_rings == NULL)
+		return (ENXIO);
+
+	error = sysctl_wire_old_buffer(req, 0);
+	if (error != 0)
+		return (error);
+
+	sbuf_new_for_sysctl(&sb, NULL, 1024, req);
+	sbuf_putc(&sb, '\n');
+	drm_debug_record_format(&sb);
+	error = sbuf_finish(&sb);
+	sbuf_delete(&sb);
+
+	return (error);
+}
+SYSCTL_PROC(_dev_drm, OID_AUTO, debug_log,
+    CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_MPSAFE, NULL, 0,
+    drm_debug_log_sysctl, "A", "Contents of the debug flight recorder");
+
+static void drm_debug_record_init(void *arg __unused)
+{
+	struct drm_debug_ring **rings;
+	int cpu;
+
+	rings = malloc(sizeof(*rings) * (mp_maxid + 1), M_DEVBUF,
+	    M_WAITOK | M_ZERO);
+	CPU_FOREACH(cpu)
+		rings[cpu] = malloc(sizeof(**rings), M_DEVBUF,
+		    M_WAITOK | M_ZERO);
+	atomic_store_rel_ptr((uintptr_t *)&drm_debug_rings, (uintptr_t)rings);
+}
+SYSINIT(drm_debug_record, SI_SUB_DRIVERS, SI_ORDER_FIRST,
+    drm_debug_record_init, NULL);
+
+static void drm_debug_record_fini(void *arg __unused)
+{
+	struct drm_debug_ring **rings;
+	int cpu;
+
+	rings = drm_debug_rings;
+	drm_debug_rings = NULL;
+	CPU_FOREACH(cpu)
+		free(rings[cpu], M_DEVBUF);
+	free(rings, M_DEVBUF);
+}
+SYSUNINIT(drm_debug_record, SI_SUB_DRIVERS, SI_ORDER_FIRST,
+    drm_debug_record_fini, NULL);
+#endif
+
 void __drm_puts_coredump(struct drm_printer *p, const char *str)
 {
 	struct drm_print_iterator *iterator = p->arg;
@@ -271,6 +481,13 @@ void drm_dev_dbg(const struct device *dev, enum drm_debug_category category,
 	struct va_format vaf;
 	va_list args;
 
+#ifdef __FreeBSD__
+	if (drm_debug_recorded(category)) {
+		va_start(args, format);
+		drm_debug_record(__builtin_return_address(0), format, args);
+		va_end(args);
+	}
+#endif
 	if (!drm_debug_enabled(category))
 		return;
 
@@ -299,6 +516,13 @@ void __drm_dbg(enum drm_debug_category category, const char *format, ...)
 	struct va_format vaf;
 	va_list args;
 
+#ifdef __FreeBSD__
+	if (drm_debug_recorded(category)) {
+		va_start(args, format);
+		drm_debug_record(__builtin_return_address(0), format, args);
+		va_end(args);
+	}
+#endif
 	if (!drm_debug_enabled(category))
 		return;
 
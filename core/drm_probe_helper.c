@@ -401,11 +401,13 @@ int drm_helper_probe_single_connector_modes(struct drm_connector *connector,
 	int count = 0, ret;
 	int mode_flags = 0;
 	bool verbose_prune = true;
+	bool early_unlock;
 	enum drm_connector_status old_status;
 	struct drm_modeset_acquire_ctx ctx;
 
 	WARN_ON(!mutex_is_locked(&dev->mode_config.mutex));
 
+	early_unlock = connector->parallel_probe;
 	drm_modeset_acquire_init(&ctx, 0);
 
 	DRM_DEBUG_KMS("[CONNECTOR:%d:%s]\n", connector->base.id,
@@ -476,6 +478,18 @@ retry:
 
 	dev->mode_config.poll_running = drm_kms_helper_poll;
 
+	/*
+	 * When drm_client_modeset_probe() probes the connectors from
+	 * parallel workers it holds mode_config.mutex for all of them and
+	 * nothing else can touch the connectors. get_modes() may spend a
+	 * long time reading EDID over DDC, so drop connection_mutex here
+	 * rather than serialise the workers on it.
+	 */
+	if (early_unlock) {
+		drm_modeset_drop_locks(&ctx);
+		drm_modeset_acquire_fini(&ctx);
+	}
+
 	if (connector->status == connector_status_disconnected) {
 		DRM_DEBUG_KMS("[CONNECTOR:%d:%s] disconnected\n",
 			connector->base.id, connector->name);
@@ -530,11 +544,15 @@ retry:
 prune:
 	drm_mode_prune_invalid(dev, &connector->modes, verbose_prune);
 
-	drm_modeset_drop_locks(&ctx);
-	drm_modeset_acquire_fini(&ctx);
+	if (!early_unlock) {
+		drm_modeset_drop_locks(&ctx);
+		drm_modeset_acquire_fini(&ctx);
+	}
 
-	if (list_empty(&connector->modes))
+	if (list_empty(&connector->modes)) {
+		drm_connector_update_probe_snapshot(connector);
 		return 0;
+	}
 
 	list_for_each_entry(mode, &connector->modes, head)
 		mode->vrefresh = drm_mode_vrefresh(mode);
@@ -548,6 +566,8 @@ prune:
 		drm_mode_debug_printmodeline(mode);
 	}
 
+	drm_connector_update_probe_snapshot(connector);
+
 	return count;
 }
 EXPORT_SYMBOL(drm_helper_probe_single_connector_modes);
@@ -654,6 +674,7 @@ static void output_poll_execute(struct work_struct *work)
 				      connector->name,
 				      old, new);
 
+			drm_connector_invalidate_probe_snapshot(connector);
 			changed = true;
 		}
 	}
@@ -801,8 +822,10 @@ bool drm_helper_hpd_irq_event(struct drm_device *dev)
 			      connector->name,
 			      drm_get_connector_status_name(old_status),
 			      drm_get_connector_status_name(connector->status));
-		if (old_status != connector->status)
+		if (old_status != connector->status) {
+			drm_connector_invalidate_probe_snapshot(connector);
 			changed = true;
+		}
 	}
 	drm_connector_list_iter_end(&conn_iter);
 	mutex_unlock(&dev->mode_config.mutex);
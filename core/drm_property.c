@@ -20,7 +20,9 @@
  * OF THIS SOFTWARE.
  */
 
+#include <linux/atomic.h>
 #include <linux/export.h>
+#include <linux/moduleparam.h>
 #include <linux/uaccess.h>
 
 #include <drm/drm_crtc.h>
@@ -31,6 +33,29 @@
 
 #include "drm_crtc_internal.h"
 
+static atomic64_t drm_property_blobs_created;
+static atomic64_t drm_property_blobs_deduped;
+
+#ifdef __FreeBSD__
+static int
+drm_property_blob_stat_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	uint64_t val;
+
+	val = atomic64_read((atomic64_t *)arg1);
+	return (sysctl_handle_64(oidp, &val, 0, req));
+}
+
+SYSCTL_PROC(_dev_drm, OID_AUTO, blobs_created,
+    CTLTYPE_U64 | CTLFLAG_RD | CTLFLAG_MPSAFE, &drm_property_blobs_created, 0,
+    drm_property_blob_stat_sysctl, "QU",
+    "Number of property blobs allocated");
+SYSCTL_PROC(_dev_drm, OID_AUTO, blobs_deduped,
+    CTLTYPE_U64 | CTLFLAG_RD | CTLFLAG_MPSAFE, &drm_property_blobs_deduped, 0,
+    drm_property_blob_stat_sysctl, "QU",
+    "Number of property blob creations satisfied by an identical blob");
+#endif
+
 /**
  * DOC: overview
  *
@@ -533,6 +558,7 @@ static void drm_property_free_blob(struct kref *kref)
 
 	mutex_lock(&blob->dev->mode_config.blob_lock);
 	list_del(&blob->head_global);
+	hlist_del_init(&blob->head_hash);
 	mutex_unlock(&blob->dev->mode_config.blob_lock);
 
 	drm_mode_object_unregister(blob->dev, &blob->base);
@@ -540,6 +566,49 @@ static void drm_property_free_blob(struct kref *kref)
 	kvfree(blob);
 }
 
+static u32 drm_property_blob_hash(const void *data, size_t length)
+{
+	const u8 *p = data;
+	u32 hash = 2166136261u;
+
+	/* FNV-1a */
+	while (length--) {
+		hash ^= *p++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static struct hlist_head *
+drm_property_blob_bucket(struct drm_device *dev, u32 hash)
+{
+	return &dev->mode_config.property_blob_hash[hash &
+	    (ARRAY_SIZE(dev->mode_config.property_blob_hash) - 1)];
+}
+
+static struct drm_property_blob *
+drm_property_find_blob(struct drm_device *dev, size_t length,
+		       const void *data, u32 hash)
+{
+	struct drm_property_blob *blob;
+
+	lockdep_assert_held(&dev->mode_config.blob_lock);
+
+	hlist_for_each_entry(blob, drm_property_blob_bucket(dev, hash),
+			     head_hash) {
+		if (blob->hash != hash || blob->length != length ||
+		    memcmp(blob->data, data, length) != 0)
+			continue;
+		/* Skip blobs which are already on their way out. */
+		if (!kref_get_unless_zero(&blob->base.refcount))
+			continue;
+		return blob;
+	}
+
+	return NULL;
+}
+
 /**
  * drm_property_create_blob - Create new blob property
  * @dev: DRM device to create property for
@@ -550,6 +619,12 @@ static void drm_property_free_blob(struct kref *kref)
  * copying data. Note that blob properties are meant to be invariant, hence the
  * data must be filled out before the blob is used as the value of any property.
  *
+ * When @data is specified the blob is content-addressed: if a blob with the
+ * same contents already exists, a new reference to it is returned instead of
+ * a copy. Callers must therefore never modify the data of a blob created
+ * this way. Blobs created without @data are always new, since their contents
+ * are only filled in afterwards.
+ *
  * Returns:
  * New blob property with a single reference on success, or an ERR_PTR
  * value on failure.
@@ -558,12 +633,25 @@ struct drm_property_blob *
 drm_property_create_blob(struct drm_device *dev, size_t length,
 			 const void *data)
 {
-	struct drm_property_blob *blob;
+	struct drm_property_blob *blob, *dup;
+	u32 hash = 0;
 	int ret;
 
 	if (!length || length > INT_MAX - sizeof(struct drm_property_blob))
 		return ERR_PTR(-EINVAL);
 
+	if (data) {
+		hash = drm_property_blob_hash(data, length);
+
+		mutex_lock(&dev->mode_config.blob_lock);
+		blob = drm_property_find_blob(dev, length, data, hash);
+		mutex_unlock(&dev->mode_config.blob_lock);
+		if (blob) {
+			atomic64_inc(&drm_property_blobs_deduped);
+			return blob;
+		}
+	}
+
 	blob = kvzalloc(sizeof(struct drm_property_blob)+length, GFP_KERNEL);
 	if (!blob)
 		return ERR_PTR(-ENOMEM);
@@ -571,9 +659,11 @@ drm_property_create_blob(struct drm_device *dev, size_t length,
 	/* This must be explicitly initialised, so we can safely call list_del
 	 * on it in the removal handler, even if it isn't in a file list. */
 	INIT_LIST_HEAD(&blob->head_file);
+	INIT_HLIST_NODE(&blob->head_hash);
 	blob->data = (void *)blob + sizeof(*blob);
 	blob->length = length;
 	blob->dev = dev;
+	blob->hash = hash;
 
 	if (data)
 		memcpy(blob->data, data, length);
@@ -586,10 +676,28 @@ drm_property_create_blob(struct drm_device *dev, size_t length,
 	}
 
 	mutex_lock(&dev->mode_config.blob_lock);
+	if (data) {
+		/*
+		 * Somebody may have created the same blob while we were
+		 * allocating; prefer theirs so there is only ever one.
+		 */
+		dup = drm_property_find_blob(dev, length, data, hash);
+		if (dup) {
+			mutex_unlock(&dev->mode_config.blob_lock);
+			drm_mode_object_unregister(dev, &blob->base);
+			kvfree(blob);
+			atomic64_inc(&drm_property_blobs_deduped);
+			return dup;
+		}
+		hlist_add_head(&blob->head_hash,
+			       drm_property_blob_bucket(dev, hash));
+	}
 	list_add_tail(&blob->head_global,
 	              &dev->mode_config.property_blob_list);
 	mutex_unlock(&dev->mode_config.blob_lock);
 
+	atomic64_inc(&drm_property_blobs_created);
+
 	return blob;
 }
 EXPORT_SYMBOL(drm_property_create_blob);
@@ -736,21 +844,31 @@ EXPORT_SYMBOL(drm_property_replace_global_blob);
  * @blob: a pointer to the member blob to be replaced
  * @new_blob: the new blob to replace with
  *
- * Return: true if the blob was in fact replaced.
+ * The pointer is always updated, but replacing a blob with a different blob
+ * holding byte-identical data is not reported as a change. This lets drivers
+ * skip reprogramming the hardware when userspace re-creates an unchanged
+ * LUT or CTM blob for every commit.
+ *
+ * Return: true if the blob contents were in fact replaced.
  */
 bool drm_property_replace_blob(struct drm_property_blob **blob,
 			       struct drm_property_blob *new_blob)
 {
 	struct drm_property_blob *old_blob = *blob;
+	bool changed;
 
 	if (old_blob == new_blob)
 		return false;
 
+	changed = !old_blob || !new_blob ||
+		  old_blob->length != new_blob->length ||
+		  memcmp(old_blob->data, new_blob->data, old_blob->length) != 0;
+
 	drm_property_blob_put(old_blob);
 	if (new_blob)
 		drm_property_blob_get(new_blob);
 	*blob = new_blob;
-	return true;
+	return changed;
 }
 EXPORT_SYMBOL(drm_property_replace_blob);
 
@@ -170,14 +170,14 @@ static void store_vblank(struct drm_device *dev, unsigned int pipe,
 {
 	struct drm_vblank_crtc *vblank = &dev->vblank[pipe];
 
-	assert_spin_locked(&dev->vblank_time_lock);
+	assert_spin_locked(&vblank->time_lock);
 
 	vblank->last = last;
 
-	write_seqlock(&vblank->seqlock);
+	write_seqcount_begin(&vblank->seqcount);
 	vblank->time = t_vblank;
 	atomic64_add(vblank_count_inc, &vblank->count);
-	write_sequnlock(&vblank->seqlock);
+	write_seqcount_end(&vblank->seqcount);
 }
 
 static u32 drm_max_vblank_count(struct drm_device *dev, unsigned int pipe)
@@ -220,17 +220,18 @@ static u32 __get_vblank_counter(struct drm_device *dev, unsigned int pipe)
  *
  * Only to be called from drm_crtc_vblank_on().
  *
- * Note: caller must hold &drm_device.vbl_lock since this reads & writes
+ * Note: caller must hold &drm_vblank_crtc.lock since this reads & writes
  * device vblank fields.
  */
 static void drm_reset_vblank_timestamp(struct drm_device *dev, unsigned int pipe)
 {
+	struct drm_vblank_crtc *vblank = &dev->vblank[pipe];
 	u32 cur_vblank;
 	bool rc;
 	ktime_t t_vblank;
 	int count = DRM_TIMESTAMP_MAXRETRIES;
 
-	spin_lock(&dev->vblank_time_lock);
+	spin_lock(&vblank->time_lock);
 
 	/*
 	 * sample the current counter to avoid random jumps
@@ -255,7 +256,7 @@ static void drm_reset_vblank_timestamp(struct drm_device *dev, unsigned int pipe
 	 */
 	store_vblank(dev, pipe, 1, t_vblank, cur_vblank);
 
-	spin_unlock(&dev->vblank_time_lock);
+	spin_unlock(&vblank->time_lock);
 }
 
 /*
@@ -267,7 +268,7 @@ static void drm_reset_vblank_timestamp(struct drm_device *dev, unsigned int pipe
  * Only necessary when going from off->on, to account for frames we
  * didn't get an interrupt for.
  *
- * Note: caller must hold &drm_device.vbl_lock since this reads & writes
+ * Note: caller must hold &drm_vblank_crtc.lock since this reads & writes
  * device vblank fields.
  */
 static void drm_update_vblank_count(struct drm_device *dev, unsigned int pipe,
@@ -373,10 +374,10 @@ static u64 drm_vblank_count(struct drm_device *dev, unsigned int pipe)
 
 	/*
 	 * This read barrier corresponds to the implicit write barrier of the
-	 * write seqlock in store_vblank(). Note that this is the only place
+	 * write seqcount in store_vblank(). Note that this is the only place
 	 * where we need an explicit barrier, since all other access goes
 	 * through drm_vblank_count_and_time(), which already has the required
-	 * read barrier curtesy of the read seqlock.
+	 * read barrier curtesy of the read seqcount.
 	 */
 	smp_rmb();
 
@@ -405,12 +406,12 @@ u64 drm_crtc_accurate_vblank_count(struct drm_crtc *crtc)
 		  !crtc->funcs->get_vblank_timestamp,
 		  "This function requires support for accurate vblank timestamps.");
 
-	spin_lock_irqsave(&dev->vblank_time_lock, flags);
+	spin_lock_irqsave(&dev->vblank[pipe].time_lock, flags);
 
 	drm_update_vblank_count(dev, pipe, false);
 	vblank = drm_vblank_count(dev, pipe);
 
-	spin_unlock_irqrestore(&dev->vblank_time_lock, flags);
+	spin_unlock_irqrestore(&dev->vblank[pipe].time_lock, flags);
 
 	return vblank;
 }
@@ -442,13 +443,13 @@ void drm_vblank_disable_and_save(struct drm_device *dev, unsigned int pipe)
 	struct drm_vblank_crtc *vblank = &dev->vblank[pipe];
 	unsigned long irqflags;
 
-	assert_spin_locked(&dev->vbl_lock);
+	assert_spin_locked(&vblank->lock);
 
 	/* Prevent vblank irq processing while disabling vblank irqs,
 	 * so no updates of timestamps or count can happen after we've
 	 * disabled. Needed to prevent races in case of delayed irq's.
 	 */
-	spin_lock_irqsave(&dev->vblank_time_lock, irqflags);
+	spin_lock_irqsave(&vblank->time_lock, irqflags);
 
 	/*
 	 * Update vblank count and disable vblank interrupts only if the
@@ -470,7 +471,7 @@ void drm_vblank_disable_and_save(struct drm_device *dev, unsigned int pipe)
 	vblank->enabled = false;
 
 out:
-	spin_unlock_irqrestore(&dev->vblank_time_lock, irqflags);
+	spin_unlock_irqrestore(&vblank->time_lock, irqflags);
 }
 
 static void vblank_disable_fn(struct timer_list *t)
@@ -480,12 +481,12 @@ static void vblank_disable_fn(struct timer_list *t)
 	unsigned int pipe = vblank->pipe;
 	unsigned long irqflags;
 
-	spin_lock_irqsave(&dev->vbl_lock, irqflags);
+	spin_lock_irqsave(&vblank->lock, irqflags);
 	if (atomic_read(&vblank->refcount) == 0 && vblank->enabled) {
 		DRM_DEBUG("disabling vblank on crtc %u\n", pipe);
 		drm_vblank_disable_and_save(dev, pipe);
 	}
-	spin_unlock_irqrestore(&dev->vbl_lock, irqflags);
+	spin_unlock_irqrestore(&vblank->lock, irqflags);
 }
 
 void drm_vblank_cleanup(struct drm_device *dev)
@@ -527,9 +528,6 @@ int drm_vblank_init(struct drm_device *dev, unsigned int num_crtcs)
 	int ret = -ENOMEM;
 	unsigned int i;
 
-	spin_lock_init(&dev->vbl_lock);
-	spin_lock_init(&dev->vblank_time_lock);
-
 	dev->num_crtcs = num_crtcs;
 
 	dev->vblank = kcalloc(num_crtcs, sizeof(*dev->vblank), GFP_KERNEL);
@@ -543,7 +541,9 @@ int drm_vblank_init(struct drm_device *dev, unsigned int num_crtcs)
 		vblank->pipe = i;
 		init_waitqueue_head(&vblank->queue);
 		timer_setup(&vblank->disable_timer, vblank_disable_fn, 0);
-		seqlock_init(&vblank->seqlock);
+		spin_lock_init(&vblank->lock);
+		spin_lock_init(&vblank->time_lock);
+		seqcount_init(&vblank->seqcount);
 	}
 
 	DRM_INFO("Supports vblank timestamp caching Rev 2 (21.10.2013).\n");
@@ -938,10 +938,10 @@ static u64 drm_vblank_count_and_time(struct drm_device *dev, unsigned int pipe,
 	}
 
 	do {
-		seq = read_seqbegin(&vblank->seqlock);
+		seq = read_seqcount_begin(&vblank->seqcount);
 		vblank_count = atomic64_read(&vblank->count);
 		*vblanktime = vblank->time;
-	} while (read_seqretry(&vblank->seqlock, seq));
+	} while (read_seqcount_retry(&vblank->seqcount, seq));
 
 	return vblank_count;
 }
@@ -973,6 +973,57 @@ u64 drm_crtc_vblank_count_and_time(struct drm_crtc *crtc,
 }
 EXPORT_SYMBOL(drm_crtc_vblank_count_and_time);
 
+/**
+ * drm_crtc_next_vblank_start - calculate the time of the next vblank
+ * @crtc: the crtc for which to calculate next vblank time
+ * @vblanktime: pointer to time to receive the next vblank timestamp.
+ *
+ * Calculate the expected time of the start of the next vblank period,
+ * based on the timestamp of the last vblank and the frame duration.
+ *
+ * Returns:
+ * 0 on success, -EINVAL if the CRTC has no vblank timing yet.
+ */
+int drm_crtc_next_vblank_start(struct drm_crtc *crtc, ktime_t *vblanktime)
+{
+	struct drm_device *dev = crtc->dev;
+	struct drm_vblank_crtc *vblank;
+	struct drm_display_mode *mode;
+	u64 vblank_start, frames;
+	ktime_t now;
+
+	if (!drm_dev_has_vblank(dev))
+		return -EINVAL;
+
+	vblank = &dev->vblank[drm_crtc_index(crtc)];
+	mode = &vblank->hwmode;
+
+	if (!vblank->framedur_ns || !mode->crtc_vtotal)
+		return -EINVAL;
+
+	drm_crtc_vblank_count_and_time(crtc, vblanktime);
+	if (!*vblanktime)
+		return -EINVAL;
+
+	/* Timestamps are taken at the end of vblank, i.e. scanout start */
+	vblank_start = DIV_ROUND_DOWN_ULL((u64)vblank->framedur_ns *
+					  mode->crtc_vblank_start,
+					  mode->crtc_vtotal);
+	*vblanktime = ktime_add_ns(*vblanktime, vblank_start);
+
+	/* The timestamp goes stale while the vblank interrupt is off */
+	now = ktime_get();
+	if (ktime_before(*vblanktime, now)) {
+		frames = div64_u64(ktime_to_ns(ktime_sub(now, *vblanktime)),
+				   vblank->framedur_ns) + 1;
+		*vblanktime = ktime_add_ns(*vblanktime,
+					   frames * vblank->framedur_ns);
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(drm_crtc_next_vblank_start);
+
 static void send_vblank_event(struct drm_device *dev,
 		struct drm_pending_vblank_event *e,
 		u64 seq, ktime_t now)
@@ -1107,13 +1158,13 @@ static int drm_vblank_enable(struct drm_device *dev, unsigned int pipe)
 	struct drm_vblank_crtc *vblank = &dev->vblank[pipe];
 	int ret = 0;
 
-	assert_spin_locked(&dev->vbl_lock);
+	assert_spin_locked(&vblank->lock);
 
-	spin_lock(&dev->vblank_time_lock);
+	spin_lock(&vblank->time_lock);
 
 	if (!vblank->enabled) {
 		/*
-		 * Enable vblank irqs under vblank_time_lock protection.
+		 * Enable vblank irqs under time_lock protection.
 		 * All vblank count & timestamp updates are held off
 		 * until we are done reinitializing master counter and
 		 * timestamps. Filtercode in drm_handle_vblank() will
@@ -1134,7 +1185,7 @@ static int drm_vblank_enable(struct drm_device *dev, unsigned int pipe)
 		}
 	}
 
-	spin_unlock(&dev->vblank_time_lock);
+	spin_unlock(&vblank->time_lock);
 
 	return ret;
 }
@@ -1151,7 +1202,7 @@ static int drm_vblank_get(struct drm_device *dev, unsigned int pipe)
 	if (WARN_ON(pipe >= dev->num_crtcs))
 		return -EINVAL;
 
-	spin_lock_irqsave(&dev->vbl_lock, irqflags);
+	spin_lock_irqsave(&vblank->lock, irqflags);
 	/* Going from 0->1 means we have to enable interrupts again */
 	if (atomic_add_return(1, &vblank->refcount) == 1) {
 		ret = drm_vblank_enable(dev, pipe);
@@ -1161,7 +1212,7 @@ static int drm_vblank_get(struct drm_device *dev, unsigned int pipe)
 			ret = -EINVAL;
 		}
 	}
-	spin_unlock_irqrestore(&dev->vbl_lock, irqflags);
+	spin_unlock_irqrestore(&vblank->lock, irqflags);
 
 	return ret;
 }
@@ -1294,7 +1345,7 @@ void drm_crtc_vblank_off(struct drm_crtc *crtc)
 
 	spin_lock_irqsave(&dev->event_lock, irqflags);
 
-	spin_lock(&dev->vbl_lock);
+	spin_lock(&vblank->lock);
 	DRM_DEBUG_VBL("crtc %d, vblank enabled %d, inmodeset %d\n",
 		      pipe, vblank->enabled, vblank->inmodeset);
 
@@ -1313,7 +1364,7 @@ void drm_crtc_vblank_off(struct drm_crtc *crtc)
 		atomic_inc(&vblank->refcount);
 		vblank->inmodeset = 1;
 	}
-	spin_unlock(&dev->vbl_lock);
+	spin_unlock(&vblank->lock);
 
 	/* Send any queued vblank events, lest the natives grow disquiet */
 	seq = drm_vblank_count_and_time(dev, pipe, &now);
@@ -1355,7 +1406,7 @@ void drm_crtc_vblank_reset(struct drm_crtc *crtc)
 	unsigned int pipe = drm_crtc_index(crtc);
 	struct drm_vblank_crtc *vblank = &dev->vblank[pipe];
 
-	spin_lock_irqsave(&dev->vbl_lock, irqflags);
+	spin_lock_irqsave(&vblank->lock, irqflags);
 	/*
 	 * Prevent subsequent drm_vblank_get() from enabling the vblank
 	 * interrupt by bumping the refcount.
@@ -1364,7 +1415,7 @@ void drm_crtc_vblank_reset(struct drm_crtc *crtc)
 		atomic_inc(&vblank->refcount);
 		vblank->inmodeset = 1;
 	}
-	spin_unlock_irqrestore(&dev->vbl_lock, irqflags);
+	spin_unlock_irqrestore(&vblank->lock, irqflags);
 
 	WARN_ON(!list_empty(&dev->vblank_event_list));
 }
@@ -1421,7 +1472,7 @@ void drm_crtc_vblank_on(struct drm_crtc *crtc)
 	if (WARN_ON(pipe >= dev->num_crtcs))
 		return;
 
-	spin_lock_irqsave(&dev->vbl_lock, irqflags);
+	spin_lock_irqsave(&vblank->lock, irqflags);
 	DRM_DEBUG_VBL("crtc %d, vblank enabled %d, inmodeset %d\n",
 		      pipe, vblank->enabled, vblank->inmodeset);
 
@@ -1439,7 +1490,7 @@ void drm_crtc_vblank_on(struct drm_crtc *crtc)
 	 */
 	if (atomic_read(&vblank->refcount) != 0 || drm_vblank_offdelay == 0)
 		WARN_ON(drm_vblank_enable(dev, pipe));
-	spin_unlock_irqrestore(&dev->vbl_lock, irqflags);
+	spin_unlock_irqrestore(&vblank->lock, irqflags);
 }
 EXPORT_SYMBOL(drm_crtc_vblank_on);
 
@@ -1468,10 +1519,10 @@ void drm_vblank_restore(struct drm_device *dev, unsigned int pipe)
 	if (WARN_ON(pipe >= dev->num_crtcs))
 		return;
 
-	assert_spin_locked(&dev->vbl_lock);
-	assert_spin_locked(&dev->vblank_time_lock);
-
 	vblank = &dev->vblank[pipe];
+
+	assert_spin_locked(&vblank->lock);
+	assert_spin_locked(&vblank->time_lock);
 	WARN_ONCE(drm_debug_enabled(DRM_UT_VBL) && !vblank->framedur_ns,
 		  "Cannot compute missed vblanks without frame duration\n");
 	framedur_ns = vblank->framedur_ns;
@@ -1548,9 +1599,9 @@ static void drm_legacy_vblank_post_modeset(struct drm_device *dev,
 		return;
 
 	if (vblank->inmodeset) {
-		spin_lock_irqsave(&dev->vbl_lock, irqflags);
+		spin_lock_irqsave(&vblank->lock, irqflags);
 		drm_reset_vblank_timestamp(dev, pipe);
-		spin_unlock_irqrestore(&dev->vbl_lock, irqflags);
+		spin_unlock_irqrestore(&vblank->lock, irqflags);
 
 		if (vblank->inmodeset & 0x2)
 			drm_vblank_put(dev, pipe);
@@ -1915,18 +1966,18 @@ bool drm_handle_vblank(struct drm_device *dev, unsigned int pipe)
 	 * vblank enable/disable, as this would cause inconsistent
 	 * or corrupted timestamps and vblank counts.
 	 */
-	spin_lock(&dev->vblank_time_lock);
+	spin_lock(&vblank->time_lock);
 
 	/* Vblank irq handling disabled. Nothing to do. */
 	if (!vblank->enabled) {
-		spin_unlock(&dev->vblank_time_lock);
+		spin_unlock(&vblank->time_lock);
 		spin_unlock_irqrestore(&dev->event_lock, irqflags);
 		return false;
 	}
 
 	drm_update_vblank_count(dev, pipe, true);
 
-	spin_unlock(&dev->vblank_time_lock);
+	spin_unlock(&vblank->time_lock);
 
 	wake_up(&vblank->queue);
 
@@ -28,6 +28,8 @@
 #ifndef DRM_ATOMIC_H_
 #define DRM_ATOMIC_H_
 
+#include <linux/ktime.h>
+
 #include <drm/drm_crtc.h>
 #include <drm/drm_util.h>
 
@@ -176,6 +178,14 @@ struct __drm_crtcs_state {
 
 	s32 __user *out_fence_ptr;
 	u64 last_vblank_count;
+
+	/**
+	 * @target_vblank_count:
+	 *
+	 * Vblank the commit is expected to land on, 0 if unknown. Set by
+	 * drm_atomic_helper_commit() for the missed frame statistics.
+	 */
+	u64 target_vblank_count;
 };
 
 struct __drm_connnectors_state {
@@ -375,6 +385,14 @@ struct drm_atomic_state {
 	 * commit without blocking.
 	 */
 	struct work_struct commit_work;
+
+	/**
+	 * @commit_start:
+	 *
+	 * Time drm_atomic_helper_commit() was called, 0 if commit statistics
+	 * are disabled.
+	 */
+	ktime_t commit_start;
 };
 
 void __drm_crtc_commit_free(struct kref *kref);
@@ -0,0 +1,30 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * $FreeBSD$
+ */
+
+#ifndef __DRM_BOOT_TIMELINE_H__
+#define __DRM_BOOT_TIMELINE_H__
+
+struct drm_device;
+
+enum drm_boot_event {
+	DRM_BOOT_PROBE_START,
+	DRM_BOOT_PROBE_END,
+	DRM_BOOT_FIRST_MODESET,
+	DRM_BOOT_FIRST_FBDEV,
+};
+
+#ifdef __FreeBSD__
+void drm_boot_timeline_record(struct drm_device *dev,
+    enum drm_boot_event event, const char *what);
+#else
+static inline void
+drm_boot_timeline_record(struct drm_device *dev, enum drm_boot_event event,
+    const char *what)
+{
+}
+#endif
+
+#endif /* __DRM_BOOT_TIMELINE_H__ */
@@ -35,10 +35,17 @@
 
 #include <linux/scatterlist.h>
 
+enum dma_data_direction;
+
 void drm_clflush_pages(struct page *pages[], unsigned long num_pages);
 void drm_clflush_sg(struct sg_table *st);
 void drm_clflush_virt_range(void *addr, unsigned long length);
 bool drm_need_swiotlb(int dma_bits);
+#ifdef __FreeBSD__
+void drm_cache_sync_pages(struct page *pages[], unsigned long offset,
+			  unsigned long length, enum dma_data_direction dir,
+			  bool for_cpu);
+#endif
 
 
 static inline bool drm_arch_can_wc_memory(void)
@@ -27,6 +27,7 @@
 #include <linux/llist.h>
 #include <linux/ctype.h>
 #include <linux/hdmi.h>
+#include <linux/workqueue.h>
 #include <drm/drm_mode_object.h>
 #include <drm/drm_util.h>
 
@@ -789,7 +790,8 @@ struct drm_connector_funcs {
 	 * The drivers must also prune any modes no longer valid from
 	 * &drm_connector.modes. Furthermore it must update
 	 * &drm_connector.status and &drm_connector.edid.  If no EDID has been
-	 * received for this output connector->edid must be NULL.
+	 * received for this output connector->edid must be NULL. Finally it
+	 * must call drm_connector_update_probe_snapshot().
 	 *
 	 * Drivers using the probe helpers should use
 	 * drm_helper_probe_single_connector_modes() to implement this
@@ -1224,6 +1226,58 @@ struct drm_connector {
 	 */
 	struct list_head probed_modes;
 
+	/**
+	 * @probe_lock:
+	 * Protects @probe_generation, @probe_changed and the snapshot of the
+	 * last completed probe (@probe_cached and the other probe_ fields).
+	 * Never held across a probe, so GETCONNECTOR can be answered from the
+	 * snapshot without waiting for &drm_mode_config.mutex or
+	 * &drm_mode_config.connection_mutex. The snapshot is only kept while
+	 * GETCONNECTOR is answered asynchronously.
+	 */
+	struct mutex probe_lock;
+
+	/**
+	 * @probe_work: Reprobes the connector in the background when
+	 * GETCONNECTOR is answered from the probe snapshot.
+	 */
+	struct work_struct probe_work;
+
+	/**
+	 * @probe_generation: Number of completed probes, also exposed as the
+	 * "PROBE_GENERATION" property. Protected by @probe_lock.
+	 */
+	u64 probe_generation;
+
+	/** @probe_cached: The snapshot below is valid. */
+	bool probe_cached;
+	/**
+	 * @probe_changed: Set when a probe changed the snapshot, cleared by
+	 * the background reprobe to decide whether to send a hotplug event.
+	 */
+	bool probe_changed;
+
+	/** @probe_modes: Copy of @modes as of the last completed probe. */
+	struct drm_display_mode *probe_modes;
+	/** @probe_mode_count: Number of entries in @probe_modes. */
+	int probe_mode_count;
+	/** @probe_status: Copy of @status as of the last completed probe. */
+	enum drm_connector_status probe_status;
+	/** @probe_width_mm: Copy of &drm_display_info.width_mm. */
+	unsigned int probe_width_mm;
+	/** @probe_height_mm: Copy of &drm_display_info.height_mm. */
+	unsigned int probe_height_mm;
+	/** @probe_subpixel: Copy of &drm_display_info.subpixel_order. */
+	enum subpixel_order probe_subpixel;
+	/** @probe_encoder_id: ID of the encoder driving the connector. */
+	uint32_t probe_encoder_id;
+	/** @probe_prop_count: Number of entries in @probe_props. */
+	int probe_prop_count;
+	/** @probe_props: The connector properties at the last probe. */
+	struct drm_property *probe_props[DRM_OBJECT_MAX_PROPERTY];
+	/** @probe_prop_values: Values of @probe_props. */
+	uint64_t probe_prop_values[DRM_OBJECT_MAX_PROPERTY];
+
 	/**
 	 * @display_info: Display information is filled from EDID information
 	 * when a display is detected. For non hot-pluggable displays such as
@@ -1330,6 +1384,15 @@ struct drm_connector {
 	/** @override_edid: has the EDID been overwritten through debugfs for testing? */
 	bool override_edid;
 
+	/**
+	 * @parallel_probe: Set by drm_client_modeset_probe() while this
+	 * connector is probed from a worker, concurrently with the others.
+	 * Lets drm_helper_probe_single_connector_modes() drop
+	 * &drm_mode_config.connection_mutex once detection is done. Protected
+	 * by &drm_mode_config.mutex.
+	 */
+	bool parallel_probe;
+
 	/**
 	 * @possible_encoders: Bit mask of encoders that can drive this
 	 * connector, drm_encoder_index() determines the index into the bitfield
@@ -1583,6 +1646,8 @@ int drm_mode_create_suggested_offset_properties(struct drm_device *dev);
 int drm_connector_set_path_property(struct drm_connector *connector,
 				    const char *path);
 int drm_connector_set_tile_property(struct drm_connector *connector);
+void drm_connector_update_probe_snapshot(struct drm_connector *connector);
+void drm_connector_invalidate_probe_snapshot(struct drm_connector *connector);
 int drm_connector_update_edid_property(struct drm_connector *connector,
 				       const struct edid *edid);
 void drm_connector_set_link_status_property(struct drm_connector *connector,
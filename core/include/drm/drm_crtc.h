@@ -54,6 +54,7 @@ struct drm_file;
 struct drm_clip_rect;
 struct drm_printer;
 struct drm_self_refresh_data;
+struct drm_crtc_commit_stats;
 struct device_node;
 struct dma_fence;
 struct edid;
@@ -1172,6 +1173,12 @@ struct drm_crtc {
 	 * Initialized via drm_self_refresh_helper_init().
 	 */
 	struct drm_self_refresh_data *self_refresh_data;
+
+	/**
+	 * @commit_stats: Atomic commit phase latencies and missed frames,
+	 * maintained by the atomic helpers.
+	 */
+	struct drm_crtc_commit_stats *commit_stats;
 };
 
 /**
@@ -219,18 +219,6 @@ struct drm_device {
 	 */
 	struct drm_vblank_crtc *vblank;
 
-	/**
-	 * @vblank_time_lock:
-	 *
-	 *  Protects vblank count and time updates during vblank enable/disable
-	 */
-	spinlock_t vblank_time_lock;
-	/**
-	 * @vbl_lock: Top-level vblank references lock, wraps the low-level
-	 * @vblank_time_lock.
-	 */
-	spinlock_t vbl_lock;
-
 	/**
 	 * @max_vblank_count:
 	 *
@@ -40,6 +40,7 @@ struct dma_buf_attachment;
 struct drm_display_mode;
 struct drm_mode_create_dumb;
 struct drm_printer;
+enum dma_data_direction;
 
 /**
  * enum drm_driver_feature - feature flags
@@ -494,6 +495,29 @@ struct drm_driver {
 	int (*gem_prime_mmap)(struct drm_gem_object *obj,
 				struct vm_area_struct *vma);
 
+	/**
+	 * @gem_prime_begin_cpu_access:
+	 *
+	 * Optional hook for GEM drivers, used to implement dma-buf CPU access
+	 * in the PRIME helpers. Prepares @len bytes at @offset of the buffer
+	 * for CPU access after device access in direction @dir.
+	 */
+	int (*gem_prime_begin_cpu_access)(struct drm_gem_object *obj,
+					  enum dma_data_direction dir,
+					  unsigned long offset,
+					  unsigned long len);
+
+	/**
+	 * @gem_prime_end_cpu_access:
+	 *
+	 * Counterpart of @gem_prime_begin_cpu_access, makes CPU writes to the
+	 * range visible to the device again.
+	 */
+	int (*gem_prime_end_cpu_access)(struct drm_gem_object *obj,
+					enum dma_data_direction dir,
+					unsigned long offset,
+					unsigned long len);
+
 	/**
 	 * @dumb_create:
 	 *
@@ -368,7 +368,7 @@ struct drm_file {
 	struct selinfo	drm_rsel;
 #endif
 	struct mtx	drm_mtx;
-	int		ev_cnt;
+	u_int		ev_bytes;	/* Queued on event_list */
 };
 
 /**
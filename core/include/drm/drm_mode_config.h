@@ -30,6 +30,9 @@
 #include <linux/llist.h>
 
 #include <drm/drm_modeset_lock.h>
+#include <drm/drm_plane.h>
+
+#define DRM_PROPERTY_BLOB_HASH_BITS	6
 
 struct drm_file;
 struct drm_device;
@@ -119,6 +122,22 @@ struct drm_mode_config_funcs {
 	enum drm_mode_status (*mode_valid)(struct drm_device *dev,
 					   const struct drm_display_mode *mode);
 
+	/**
+	 * @buffer_align:
+	 *
+	 * Optional. Refine the pitch and base address alignment, in bytes, of
+	 * buffers in @format scanned out by planes of @type. Called with
+	 * @pitch_align and @base_align set to the device wide
+	 * &drm_mode_config.pitch_align and &drm_mode_config.base_align.
+	 * Pitch alignments need not be powers of two, base alignments must.
+	 *
+	 * Used by drm_mode_buffer_align() and thus by the dumb buffer and fbdev
+	 * helpers.
+	 */
+	void (*buffer_align)(struct drm_device *dev, u32 format,
+			     enum drm_plane_type type, u32 *pitch_align,
+			     u32 *base_align);
+
 	/**
 	 * @atomic_check:
 	 *
@@ -536,7 +555,7 @@ struct drm_mode_config {
 	 * @blob_lock:
 	 *
 	 * Mutex for blob property allocation and management, protects
-	 * @property_blob_list and &drm_file.blobs.
+	 * @property_blob_list, @property_blob_hash and &drm_file.blobs.
 	 */
 	struct mutex blob_lock;
 
@@ -548,6 +567,17 @@ struct drm_mode_config {
 	 */
 	struct list_head property_blob_list;
 
+	/**
+	 * @property_blob_hash:
+	 *
+	 * Hash table of the kernel-created blob property objects, indexed by
+	 * the hash of their contents and linked with
+	 * &drm_property_blob.head_hash. Used by drm_property_create_blob() to
+	 * hand out an existing blob instead of a byte-identical copy.
+	 * Protected by @blob_lock.
+	 */
+	struct hlist_head property_blob_hash[1 << DRM_PROPERTY_BLOB_HASH_BITS];
+
 	/* pointers to standard properties */
 
 	/**
@@ -576,6 +606,12 @@ struct drm_mode_config {
 	 * of a connector
 	 */
 	struct drm_property *link_status_property;
+	/**
+	 * @probe_generation_property: Default immutable connector property
+	 * counting the completed probes of a connector, so that userspace can
+	 * tell whether GETCONNECTOR returned fresh or cached probe results.
+	 */
+	struct drm_property *probe_generation_property;
 	/**
 	 * @plane_type_property: Default plane property to differentiate
 	 * CURSOR, PRIMARY and OVERLAY legacy uses of planes.
@@ -858,6 +894,24 @@ struct drm_mode_config {
 	/* dumb ioctl parameters */
 	uint32_t preferred_depth, prefer_shadow;
 
+	/**
+	 * @pitch_align:
+	 *
+	 * Pitch alignment in bytes for scanout buffers, typically the AXI
+	 * burst size of the display engine. 0 selects
+	 * DRM_DEFAULT_PITCH_ALIGN, a cache line, so that scanline fetches and
+	 * CPU blits do not straddle lines.
+	 */
+	u32 pitch_align;
+
+	/**
+	 * @base_align:
+	 *
+	 * Alignment in bytes of the start of scanout buffers, 0 if page
+	 * alignment is enough.
+	 */
+	u32 base_align;
+
 	/**
 	 * @prefer_shadow_fbdev:
 	 *
@@ -929,6 +983,15 @@ struct drm_mode_config {
 	const struct drm_mode_config_helper_funcs *helper_private;
 };
 
+#define DRM_DEFAULT_PITCH_ALIGN	64
+
+void drm_mode_buffer_align(struct drm_device *dev, u32 format,
+			   enum drm_plane_type type, u32 *pitch_align,
+			   u32 *base_align);
+u32 drm_mode_buffer_pitch(struct drm_device *dev, u32 format,
+			  enum drm_plane_type type, u32 width);
+u32 drm_mode_dumb_pitch(struct drm_device *dev, u32 width, u32 bpp);
+
 void drm_mode_config_init(struct drm_device *dev);
 void drm_mode_config_reset(struct drm_device *dev);
 void drm_mode_config_cleanup(struct drm_device *dev);
@@ -36,6 +36,9 @@
 
 /* Do *not* use outside of drm_print.[ch]! */
 extern unsigned int __drm_debug;
+#ifdef __FreeBSD__
+extern unsigned int __drm_debug_record;
+#endif
 
 /**
  * DOC: print
@@ -322,6 +325,29 @@ static inline bool drm_debug_enabled(enum drm_debug_category category)
 	return unlikely(__drm_debug & category);
 }
 
+/*
+ * Debug flight recorder: messages in the categories enabled in
+ * dev.drm.debug_record are kept in a per-CPU ring instead of (or in addition
+ * to) going to the console.
+ */
+#ifdef __FreeBSD__
+static inline bool drm_debug_recorded(enum drm_debug_category category)
+{
+	return unlikely(__drm_debug_record & category);
+}
+
+void drm_debug_record_dump(void);
+#else
+static inline bool drm_debug_recorded(enum drm_debug_category category)
+{
+	return false;
+}
+
+static inline void drm_debug_record_dump(void)
+{
+}
+#endif
+
 /*
  * struct device based logging
  *
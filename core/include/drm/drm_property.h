@@ -197,6 +197,9 @@ struct drm_property {
  * @head_global: entry on the global blob list in
  * 	&drm_mode_config.property_blob_list.
  * @head_file: entry on the per-file blob list in &drm_file.blobs list.
+ * @head_hash: entry in &drm_mode_config.property_blob_hash, only used for
+ * 	blobs created with their data already known.
+ * @hash: hash of @data, valid when @head_hash is hashed
  * @length: size of the blob in bytes, invariant over the lifetime of the object
  * @data: actual data, embedded at the end of this structure
  *
@@ -211,6 +214,8 @@ struct drm_property_blob {
 	struct drm_device *dev;
 	struct list_head head_global;
 	struct list_head head_file;
+	struct hlist_node head_hash;
+	u32 hash;
 	size_t length;
 	void *data;
 };
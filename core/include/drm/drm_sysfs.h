@@ -1,3 +1,4 @@
 /* Public Domain */
 
 void drm_sysfs_hotplug_event(struct drm_device *dev __unused);
+void drm_sysfs_lease_event(struct drm_device *dev __unused);
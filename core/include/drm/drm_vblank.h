@@ -105,9 +105,21 @@ struct drm_vblank_crtc {
 	struct timer_list disable_timer;
 
 	/**
-	 * @seqlock: Protect vblank count and time.
+	 * @lock: Protects @refcount transitions, @enabled and @inmodeset
+	 * against enabling and disabling of the vblank interrupt. Wraps the
+	 * low-level @time_lock.
 	 */
-	seqlock_t seqlock;
+	spinlock_t lock;
+	/**
+	 * @time_lock: Serializes updates of @count, @time and @last, from
+	 * the vblank interrupt and during vblank enable/disable.
+	 */
+	spinlock_t time_lock;
+	/**
+	 * @seqcount: Lets readers sample @count and @time without taking
+	 * @time_lock. Written under @time_lock.
+	 */
+	seqcount_t seqcount;
 
 	/**
 	 * @count:
@@ -136,7 +148,7 @@ struct drm_vblank_crtc {
 	 */
 	atomic_t refcount;
 	/**
-	 * @last: Protected by &drm_device.vbl_lock, used for wraparound handling.
+	 * @last: Protected by @time_lock, used for wraparound handling.
 	 */
 	u32 last;
 	/**
@@ -211,6 +223,7 @@ bool drm_dev_has_vblank(const struct drm_device *dev);
 u64 drm_crtc_vblank_count(struct drm_crtc *crtc);
 u64 drm_crtc_vblank_count_and_time(struct drm_crtc *crtc,
 				   ktime_t *vblanktime);
+int drm_crtc_next_vblank_start(struct drm_crtc *crtc, ktime_t *vblanktime);
 void drm_crtc_send_vblank_event(struct drm_crtc *crtc,
 			       struct drm_pending_vblank_event *e);
 void drm_crtc_arm_vblank_event(struct drm_crtc *crtc,
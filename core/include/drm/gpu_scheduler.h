@@ -145,6 +145,12 @@ struct drm_sched_fence {
          */
 	struct dma_fence		finished;
 
+        /**
+         * @deadline: deadline set on &drm_sched_fence.finished which
+         * potentially needs to be propagated to &drm_sched_fence.parent
+         */
+	ktime_t				deadline;
+
         /**
          * @parent: the fence returned by &drm_sched_backend_ops.run_job
          * when scheduling the job on hardware. We signal the
@@ -166,6 +172,9 @@ struct drm_sched_fence {
 	void				*owner;
 };
 
+/* Set on &drm_sched_fence.finished once a deadline was given */
+#define DRM_SCHED_FENCE_FLAG_HAS_DEADLINE_BIT	DMA_FENCE_FLAG_USER_BITS
+
 struct drm_sched_fence *to_drm_sched_fence(struct dma_fence *f);
 
 /**
@@ -340,6 +349,8 @@ struct drm_sched_fence *drm_sched_fence_create(
 	struct drm_sched_entity *s_entity, void *owner);
 void drm_sched_fence_scheduled(struct drm_sched_fence *fence);
 void drm_sched_fence_finished(struct drm_sched_fence *fence);
+void drm_sched_fence_set_parent(struct drm_sched_fence *s_fence,
+				struct dma_fence *fence);
 
 unsigned long drm_sched_suspend_timeout(struct drm_gpu_scheduler *sched);
 void drm_sched_resume_timeout(struct drm_gpu_scheduler *sched,
@@ -40,15 +40,28 @@ __FBSDID("$FreeBSD$");
 #include <sys/filio.h>
 #include <sys/kernel.h>
 #include <sys/malloc.h>
+#include <sys/mman.h>
 #include <sys/mutex.h>
+#include <sys/rwlock.h>
+#include <sys/sx.h>
 #include <sys/systm.h>
 #include <sys/unistd.h>
 
+#include <vm/vm.h>
+#include <vm/vm_extern.h>
+#include <vm/vm_object.h>
+#include <vm/vm_page.h>
+#include <vm/vm_pager.h>
+
 #include <machine/atomic.h>
 
 #include <linux/dma-buf.h>
+#include <linux/dma-fence-array.h>
 #include <linux/err.h>
+#include <linux/mm.h>
 #include <linux/reservation.h>
+#include <linux/slab.h>
+#include <linux/sync_file.h>
 
 #include <uapi/linux/dma-buf.h>
 
@@ -278,6 +291,7 @@ dmabuf_fop_close(struct file *file, struct thread *td)
 		return (EINVAL);
 
 	dmabuf = file->f_data;
+	MPASS(dmabuf->db_pager == NULL);
 
 	dmabuf->ops->release(dmabuf);
 	reservation_poll_fini(&dmabuf->db_resv_poll);
@@ -323,27 +337,260 @@ dmabuf_fop_kqfilter(struct file *file, struct knote *kn)
 	return (reservation_object_kqfilter(dmabuf->resv, kn, rpoll));
 }
 
+/*
+ * Userland mappings of a dma-buf all share one device pager object, so
+ * that mapping a buffer several times, or from several processes, sets
+ * the exporter mapping up once and faults its pages in once.  The
+ * object lives as long as any mapping of it does and holds a reference
+ * on the dma-buf file, which keeps the exporter's buffer around.  Each
+ * object gets a fresh pager handle: an object that is being torn down
+ * must not be found again by a new mmap.
+ */
+struct dma_buf_pager {
+	struct dma_buf		*dbp_dmabuf;
+	vm_object_t		dbp_obj;
+	struct vm_area_struct	dbp_vma;
+};
+
+static int
+dmabuf_pager_fault(vm_object_t vm_obj, vm_ooffset_t offset, int prot,
+    vm_page_t *mres)
+{
+	struct dma_buf_pager *pg;
+	vm_paddr_t paddr;
+	vm_page_t page;
+
+	pg = vm_obj->handle;
+	if (offset >= pg->dbp_vma.vm_len)
+		return (VM_PAGER_FAIL);
+
+	paddr = IDX_TO_OFF(pg->dbp_vma.vm_pfn) + offset;
+	if (((*mres)->flags & PG_FICTITIOUS) != 0) {
+		page = *mres;
+		vm_page_updatefake(page, paddr, vm_obj->memattr);
+	} else {
+		VM_OBJECT_WUNLOCK(vm_obj);
+		page = vm_page_getfake(paddr, vm_obj->memattr);
+		VM_OBJECT_WLOCK(vm_obj);
+		vm_page_replace(page, vm_obj, (*mres)->pindex, *mres);
+		*mres = page;
+	}
+	page->valid = VM_PAGE_BITS_ALL;
+	return (VM_PAGER_OK);
+}
+
+static int
+dmabuf_pager_populate(vm_object_t vm_obj, vm_pindex_t pidx, int fault_type,
+    vm_prot_t max_prot, vm_pindex_t *first, vm_pindex_t *last)
+{
+	struct dma_buf_pager *pg;
+	struct vm_area_struct *vma;
+	int err;
+
+	pg = vm_obj->handle;
+	vma = &pg->dbp_vma;
+
+	VM_OBJECT_WUNLOCK(vm_obj);
+	err = drmkpi_vma_fault(vma, vm_obj, pidx, fault_type);
+
+	switch (err) {
+	case VM_FAULT_OOM:
+		err = VM_PAGER_AGAIN;
+		break;
+	case VM_FAULT_SIGBUS:
+		err = VM_PAGER_BAD;
+		break;
+	case VM_FAULT_NOPAGE:
+		*first = vma->vm_pfn_first;
+		*last = *first + vma->vm_pfn_count - 1;
+		err = VM_PAGER_OK;
+		break;
+	default:
+		err = VM_PAGER_ERROR;
+		break;
+	}
+
+	VM_OBJECT_WLOCK(vm_obj);
+	return (err);
+}
+
+static int
+dmabuf_pager_ctor(void *handle, vm_ooffset_t size, vm_prot_t prot,
+    vm_ooffset_t foff, struct ucred *cred, u_short *color)
+{
+
+	*color = 0;
+	return (0);
+}
+
+static void
+dmabuf_pager_dtor(void *handle)
+{
+	struct dma_buf_pager *pg;
+	struct dma_buf *dmabuf;
+	struct vm_area_struct *vma;
+	struct file *fp;
+
+	pg = handle;
+	dmabuf = pg->dbp_dmabuf;
+	vma = &pg->dbp_vma;
+
+	sx_xlock(&dmabuf->db_sx);
+	if (dmabuf->db_pager == pg)
+		dmabuf->db_pager = NULL;
+	sx_xunlock(&dmabuf->db_sx);
+
+	if (vma->vm_ops != NULL && vma->vm_ops->close != NULL)
+		vma->vm_ops->close(vma);
+
+	/* This may be the last reference and release the dma-buf. */
+	fp = dmabuf->db_file;
+	free(pg, M_DMABUF);
+	fdrop(fp, curthread);
+}
+
+static struct cdev_pager_ops dmabuf_dev_pg_ops = {
+	/* OBJT_DEVICE */
+	.cdev_pg_fault		= dmabuf_pager_fault,
+	.cdev_pg_ctor		= dmabuf_pager_ctor,
+	.cdev_pg_dtor		= dmabuf_pager_dtor,
+};
+
+static struct cdev_pager_ops dmabuf_mgtdev_pg_ops = {
+	/* OBJT_MGTDEVICE */
+	.cdev_pg_populate	= dmabuf_pager_populate,
+	.cdev_pg_ctor		= dmabuf_pager_ctor,
+	.cdev_pg_dtor		= dmabuf_pager_dtor,
+};
+
+/*
+ * Return a referenced VM object mapping the whole of dmabuf, reusing
+ * the object of the current mappings if there are any.
+ */
+static int
+dmabuf_get_vm_object(struct dma_buf *dmabuf, struct thread *td,
+    vm_object_t *objp)
+{
+	struct dma_buf_pager *pg;
+	struct vm_area_struct *vma;
+	vm_memattr_t attr;
+	vm_object_t obj;
+	vm_size_t size;
+	int rv;
+
+	sx_assert(&dmabuf->db_sx, SA_XLOCKED);
+
+	pg = dmabuf->db_pager;
+	if (pg != NULL) {
+		/*
+		 * The object cannot be freed under us: its pager
+		 * destructor needs db_sx.  It may be dying though.
+		 */
+		obj = pg->dbp_obj;
+		VM_OBJECT_WLOCK(obj);
+		if ((obj->flags & OBJ_DEAD) == 0 && obj->ref_count > 0) {
+			vm_object_reference_locked(obj);
+			VM_OBJECT_WUNLOCK(obj);
+			*objp = obj;
+			return (0);
+		}
+		VM_OBJECT_WUNLOCK(obj);
+		dmabuf->db_pager = NULL;
+	}
+
+	size = round_page(dmabuf->size);
+	pg = malloc(sizeof(*pg), M_DMABUF, M_WAITOK | M_ZERO);
+	pg->dbp_dmabuf = dmabuf;
+	vma = &pg->dbp_vma;
+	vma->vm_start = 0;
+	vma->vm_end = size;
+	vma->vm_len = size;
+	vma->vm_flags = vma->vm_page_prot = VM_PROT_READ | VM_PROT_WRITE;
+	vma->vm_file = dmabuf->db_file;
+
+	rv = -dmabuf->ops->mmap(dmabuf, vma);
+	if (rv != 0) {
+		free(pg, M_DMABUF);
+		return (rv);
+	}
+
+	if (vma->vm_backing_obj != NULL) {
+		/*
+		 * The exporter has a VM object of its own, which all
+		 * mappings share already, e.g. the one of the DRM node
+		 * mappings of a GEM object.  We get a reference on it.
+		 */
+		obj = vma->vm_backing_obj;
+		if (vma->vm_ops != NULL && vma->vm_ops->close != NULL)
+			vma->vm_ops->close(vma);
+		free(pg, M_DMABUF);
+		*objp = obj;
+		return (0);
+	}
+
+	if (vma->vm_ops != NULL && vma->vm_ops->fault != NULL)
+		obj = cdev_pager_allocate(pg, OBJT_MGTDEVICE,
+		    &dmabuf_mgtdev_pg_ops, size, VM_PROT_ALL, 0, td->td_ucred);
+	else
+		obj = cdev_pager_allocate(pg, OBJT_DEVICE,
+		    &dmabuf_dev_pg_ops, size, VM_PROT_ALL, 0, td->td_ucred);
+	if (obj == NULL) {
+		if (vma->vm_ops != NULL && vma->vm_ops->close != NULL)
+			vma->vm_ops->close(vma);
+		free(pg, M_DMABUF);
+		return (EINVAL);
+	}
+
+	attr = pgprot2cachemode(vma->vm_page_prot);
+	if (attr != VM_MEMATTR_DEFAULT) {
+		VM_OBJECT_WLOCK(obj);
+		vm_object_set_memattr(obj, attr);
+		VM_OBJECT_WUNLOCK(obj);
+	}
+
+	/* Dropped by the pager destructor. */
+	fhold(dmabuf->db_file);
+	pg->dbp_obj = obj;
+	dmabuf->db_pager = pg;
+
+	*objp = obj;
+	return (0);
+}
+
 static int
 dmabuf_fop_mmap(struct file *file, vm_map_t map, vm_offset_t *addr,
 	     vm_size_t size, vm_prot_t prot, vm_prot_t cap_maxprot,
 	     int flags, vm_ooffset_t foff, struct thread *td)
 {
 	struct dma_buf *dmabuf;
-	struct vm_area_struct vma;
+	vm_object_t obj;
+	int rv;
 
 	if (!file_is_dmabuf(file))
 		return (EINVAL);
 
 	dmabuf = file->f_data;
 
-	if (foff + size  > dmabuf->size)
+	if (foff < 0 || foff + size  > dmabuf->size)
 		return (EINVAL);
 
-	vma.vm_start = *addr;
-	vma.vm_end = *addr + size;
-	vma.vm_pgoff = foff;
+	/* Buffers are shared with the device, private mappings are not. */
+	if ((flags & (MAP_PRIVATE | MAP_COPY)) != 0)
+		return (EINVAL);
+	if ((prot & ~cap_maxprot) != 0)
+		return (EACCES);
 
-	return (-dmabuf->ops->mmap(dmabuf, &vma));
+	sx_xlock(&dmabuf->db_sx);
+	rv = dmabuf_get_vm_object(dmabuf, td, &obj);
+	sx_xunlock(&dmabuf->db_sx);
+	if (rv != 0)
+		return (rv);
+
+	rv = vm_mmap_object(map, addr, size, prot, cap_maxprot, flags, obj,
+	    foff, FALSE, td);
+	if (rv != 0)
+		vm_object_deallocate(obj);
+	return (rv);
 }
 
 static int
@@ -371,50 +618,248 @@ dmabuf_fop_seek(struct file *file, off_t offset, int whence, struct thread *td)
 	return (0);
 }
 
+/*
+ * Wait for the device to be done with the buffer before the CPU touches
+ * it: for the writer to finish before reading, for every user to finish
+ * before writing.
+ */
+static int
+dmabuf_sync_wait(struct dma_buf *dmabuf, bool write)
+{
+	struct reservation_snapshot snap;
+	unsigned i;
+	long rv;
+
+	rv = reservation_object_snapshot(dmabuf->resv, write, &snap);
+	if (rv != 0)
+		return (rv);
+	if (snap.rs_excl != NULL)
+		rv = dma_fence_wait(snap.rs_excl, true);
+	for (i = 0; rv == 0 && i < snap.rs_nshared; i++)
+		rv = dma_fence_wait(snap.rs_shared[i], true);
+	reservation_snapshot_fini(&snap);
+	return (rv);
+}
+
+/*
+ * Hand [offset, offset + len) of the buffer over to or back from the CPU.
+ * Exporters providing only the whole-buffer operations sync all of it.
+ */
+static int
+dmabuf_sync(struct dma_buf *dmabuf, uint64_t flags, unsigned long offset,
+    unsigned long len)
+{
+	const struct dma_buf_ops *ops;
+	enum dma_data_direction dir;
+	int rv;
+
+	if (flags & ~DMA_BUF_SYNC_VALID_FLAGS_MASK)
+		return (EINVAL);
+
+	switch (flags & DMA_BUF_SYNC_RW) {
+	case DMA_BUF_SYNC_READ:
+		dir = DMA_FROM_DEVICE;
+		break;
+	case DMA_BUF_SYNC_WRITE:
+		dir = DMA_TO_DEVICE;
+		break;
+	case DMA_BUF_SYNC_RW:
+		dir = DMA_BIDIRECTIONAL;
+		break;
+	default:
+		return (EINVAL);
+	}
+
+	ops = dmabuf->ops;
+	rv = 0;
+	if (flags & DMA_BUF_SYNC_END) {
+		if (ops->end_cpu_access_partial != NULL)
+			rv = ops->end_cpu_access_partial(dmabuf, dir, offset,
+			    len);
+		else if (ops->end_cpu_access != NULL)
+			rv = ops->end_cpu_access(dmabuf, dir);
+	} else {
+		rv = dmabuf_sync_wait(dmabuf, dir != DMA_FROM_DEVICE);
+		if (rv != 0)
+			return (-rv);
+		if (ops->begin_cpu_access_partial != NULL)
+			rv = ops->begin_cpu_access_partial(dmabuf, dir, offset,
+			    len);
+		else if (ops->begin_cpu_access != NULL)
+			rv = ops->begin_cpu_access(dmabuf, dir);
+	}
+	return (-rv);
+}
+
+/*
+ * Fold the fences of snap, and extra if it is not NULL, into a single
+ * fence. Return a new reference to it, or NULL if memory is short. The
+ * snapshot keeps its own references.
+ */
+static struct dma_fence *
+dmabuf_merge_fences(const struct reservation_snapshot *snap,
+    struct dma_fence *extra)
+{
+	struct dma_fence_array *array;
+	struct dma_fence **fences;
+	unsigned i, n;
+
+	n = snap->rs_nshared + (snap->rs_excl != NULL) + (extra != NULL);
+	if (n == 0)
+		return (dma_fence_get_stub());
+	if (n == 1) {
+		if (extra != NULL)
+			return (dma_fence_get(extra));
+		if (snap->rs_excl != NULL)
+			return (dma_fence_get(snap->rs_excl));
+		return (dma_fence_get(snap->rs_shared[0]));
+	}
+
+	fences = kmalloc_array(n, sizeof(fences[0]), GFP_KERNEL);
+	if (fences == NULL)
+		return (NULL);
+	n = 0;
+	if (snap->rs_excl != NULL)
+		fences[n++] = dma_fence_get(snap->rs_excl);
+	for (i = 0; i < snap->rs_nshared; i++)
+		fences[n++] = dma_fence_get(snap->rs_shared[i]);
+	if (extra != NULL)
+		fences[n++] = dma_fence_get(extra);
+
+	array = dma_fence_array_create(n, fences, dma_fence_context_alloc(1),
+	    1, false);
+	if (array == NULL) {
+		while (n-- > 0)
+			dma_fence_put(fences[n]);
+		kfree(fences);
+		return (NULL);
+	}
+
+	return (&array->base);
+}
+
+/*
+ * Return a sync_file for the implicit fences of the buffer: the exclusive
+ * fence for a reader, every fence for a writer.
+ */
+static int
+dmabuf_export_sync_file(struct dma_buf *dmabuf,
+    struct dma_buf_export_sync_file *arg)
+{
+	struct reservation_snapshot snap;
+	struct dma_fence *fence;
+	struct sync_file *sf;
+	int fd, rv;
+
+	if ((arg->flags & ~DMA_BUF_SYNC_RW) != 0 ||
+	    (arg->flags & DMA_BUF_SYNC_RW) == 0)
+		return (EINVAL);
+
+	rv = reservation_object_snapshot(dmabuf->resv,
+	    (arg->flags & DMA_BUF_SYNC_WRITE) != 0, &snap);
+	if (rv != 0)
+		return (-rv);
+	fence = dmabuf_merge_fences(&snap, NULL);
+	reservation_snapshot_fini(&snap);
+	if (fence == NULL)
+		return (ENOMEM);
+
+	sf = sync_file_create(fence);
+	dma_fence_put(fence);
+	if (sf == NULL)
+		return (ENFILE);
+
+	rv = finstall(curthread, sf->sf_file, &fd, O_CLOEXEC, NULL);
+	/* Drop our reference, on failure this frees the sync_file. */
+	fdrop(sf->sf_file, curthread);
+	if (rv != 0)
+		return (rv);
+
+	arg->fd = fd;
+	return (0);
+}
+
+/*
+ * Add the fence of a sync_file to the buffer, as a shared fence for a
+ * reader or as the exclusive fence for a writer.
+ */
+static int
+dmabuf_import_sync_file(struct dma_buf *dmabuf,
+    struct dma_buf_import_sync_file *arg)
+{
+	struct reservation_object *robj;
+	struct reservation_snapshot snap;
+	struct dma_fence *fence, *excl;
+	int rv;
+
+	if ((arg->flags & ~DMA_BUF_SYNC_RW) != 0 ||
+	    (arg->flags & DMA_BUF_SYNC_RW) == 0)
+		return (EINVAL);
+
+	fence = sync_file_get_fence(arg->fd);
+	if (fence == NULL)
+		return (EINVAL);
+
+	robj = dmabuf->resv;
+	rv = reservation_object_lock_interruptible(robj, NULL);
+	if (rv != 0)
+		goto out;
+
+	if (arg->flags & DMA_BUF_SYNC_WRITE) {
+		/*
+		 * The exclusive fence replaces the shared ones, keep the
+		 * readers still in flight by folding them into it.
+		 */
+		rv = reservation_object_snapshot(robj, true, &snap);
+		if (rv == 0) {
+			excl = dmabuf_merge_fences(&snap, fence);
+			reservation_snapshot_fini(&snap);
+			if (excl != NULL) {
+				reservation_object_add_excl_fence(robj, excl);
+				dma_fence_put(excl);
+			} else
+				rv = -ENOMEM;
+		}
+	} else {
+		rv = reservation_object_reserve_shared(robj);
+		if (rv == 0)
+			reservation_object_add_shared_fence(robj, fence);
+	}
+
+	reservation_object_unlock(robj);
+out:
+	dma_fence_put(fence);
+	return (-rv);
+}
+
 static int
 dmabuf_fop_ioctl(struct file *file, u_long com, void *data,
 	      struct ucred *active_cred, struct thread *td)
 {
 	struct dma_buf *dmabuf;
 	struct dma_buf_sync *sync;
-	enum dma_data_direction dir;
-	int rv;
+	struct dma_buf_sync_partial *psync;
 
 	if (!file_is_dmabuf(file))
 		return (EINVAL);
 
 	dmabuf = file->f_data;
 
-	sync = data;
-	rv = 0;
-
 	switch (com) {
 	case DMA_BUF_IOCTL_SYNC:
-		if (sync->flags & ~DMA_BUF_SYNC_VALID_FLAGS_MASK)
-			return (EINVAL);
-
-		switch (sync->flags & DMA_BUF_SYNC_RW) {
-		case DMA_BUF_SYNC_READ:
-			dir = DMA_FROM_DEVICE;
-			break;
-		case DMA_BUF_SYNC_WRITE:
-			dir = DMA_TO_DEVICE;
-			break;
-		case DMA_BUF_SYNC_RW:
-			dir = DMA_BIDIRECTIONAL;
-			break;
-		default:
+		sync = data;
+		return (dmabuf_sync(dmabuf, sync->flags, 0, dmabuf->size));
+	case DMA_BUF_IOCTL_EXPORT_SYNC_FILE:
+		return (dmabuf_export_sync_file(dmabuf, data));
+	case DMA_BUF_IOCTL_IMPORT_SYNC_FILE:
+		return (dmabuf_import_sync_file(dmabuf, data));
+	case DMA_BUF_IOCTL_SYNC_PARTIAL:
+		psync = data;
+		if (psync->len == 0 ||
+		    (uint64_t)psync->offset + psync->len > dmabuf->size)
 			return (EINVAL);
-		}
-		rv = 0;
-		if (sync->flags & DMA_BUF_SYNC_END) {
-			if (dmabuf->ops->end_cpu_access != NULL)
-				rv = dmabuf->ops->end_cpu_access(dmabuf, dir);
-		} else {
-			if (dmabuf->ops->begin_cpu_access != NULL)
-				rv = dmabuf->ops->begin_cpu_access(dmabuf, dir);
-		}
-		return (-rv);
+		return (dmabuf_sync(dmabuf, psync->flags, psync->offset,
+		    psync->len));
 	default:
 		return (ENOTTY);
 	}
@@ -423,6 +423,10 @@ dma_fence_is_signaled(struct dma_fence *fence)
 
 	MPASS(dma_fence_referenced_p(fence));
 
+	/* The signalled bit is never cleared, skip the lock if set.  */
+	if (fence->flags & (1u << DMA_FENCE_FLAG_SIGNALED_BIT))
+		return true;
+
 	spin_lock(fence->lock);
 	signaled = dma_fence_is_signaled_locked(fence);
 	spin_unlock(fence->lock);
@@ -463,6 +467,25 @@ dma_fence_is_signaled_locked(struct dma_fence *fence)
 	return false;
 }
 
+/*
+ * dma_fence_set_deadline(fence, deadline)
+ *
+ *	Hint to the fence's signaller that a waiter needs the fence
+ *	signalled by deadline, a ktime_get() time, so that it can
+ *	boost or reorder the work behind it.  The signaller keeps the
+ *	earliest deadline it was given.  Does nothing if the fence has
+ *	been signalled or its ops have no set_deadline callback.
+ */
+void
+dma_fence_set_deadline(struct dma_fence *fence, ktime_t deadline)
+{
+
+	MPASS(dma_fence_referenced_p(fence));
+
+	if (fence->ops->set_deadline != NULL && !dma_fence_is_signaled(fence))
+		(*fence->ops->set_deadline)(fence, deadline);
+}
+
 /*
  * dma_fence_set_error(fence, error)
  *
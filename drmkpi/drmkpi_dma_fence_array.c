@@ -0,0 +1,217 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Fence arrays: a fence that signals once all (or, if requested, any) of
+ * a set of fences have signalled.
+ */
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include <sys/param.h>
+#include <sys/systm.h>
+
+#include <machine/atomic.h>
+
+#include <linux/atomic.h>
+#include <linux/dma-fence.h>
+#include <linux/dma-fence-array.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+static const struct dma_fence_ops dma_fence_array_ops;
+
+static const char *
+dma_fence_array_get_driver_name(struct dma_fence *fence)
+{
+
+	return ("dma_fence_array");
+}
+
+static const char *
+dma_fence_array_get_timeline_name(struct dma_fence *fence)
+{
+
+	return ("unbound");
+}
+
+/*
+ * The array is signalled from a work item rather than from the callback of
+ * the last pending fence: that callback runs with the pending fence's lock
+ * held, while enable_signaling takes the pending fences' locks with the
+ * array lock held.
+ */
+static void
+dma_fence_array_signal_work(struct work_struct *work)
+{
+	struct dma_fence_array *array;
+
+	array = container_of(work, struct dma_fence_array, fa_signal_work);
+	dma_fence_signal(&array->base);
+	dma_fence_put(&array->base);
+}
+
+static void
+dma_fence_array_set_error(struct dma_fence_array *array, int error)
+{
+
+	/* The first error wins, it is only read once the array signals. */
+	if (error != 0)
+		atomic_cmpset_int((volatile u_int *)&array->base.error, 0,
+		    error);
+}
+
+static void
+dma_fence_array_cb_func(struct dma_fence *fence, struct dma_fence_cb *cb)
+{
+	struct dma_fence_array_cb *acb;
+	struct dma_fence_array *array;
+
+	acb = container_of(cb, struct dma_fence_array_cb, cb);
+	array = acb->array;
+
+	dma_fence_array_set_error(array, fence->error);
+	if (atomic_dec_and_test(&array->fa_pending))
+		/* Hand our reference over to the work item. */
+		schedule_work(&array->fa_signal_work);
+	else
+		dma_fence_put(&array->base);
+}
+
+static bool
+dma_fence_array_enable_signaling(struct dma_fence *fence)
+{
+	struct dma_fence_array *array;
+	struct dma_fence_array_cb *acb;
+	unsigned i;
+
+	array = to_dma_fence_array(fence);
+	for (i = 0; i < array->num_fences; i++) {
+		acb = &array->fa_cb[i];
+		acb->array = array;
+		/* Each queued callback holds a reference to the array. */
+		dma_fence_get(&array->base);
+		if (dma_fence_add_callback(array->fences[i], &acb->cb,
+		    dma_fence_array_cb_func) == 0)
+			continue;
+
+		/* Already signalled, the caller still holds a reference. */
+		dma_fence_array_set_error(array, array->fences[i]->error);
+		dma_fence_put(&array->base);
+		if (atomic_dec_and_test(&array->fa_pending))
+			return (false);
+	}
+
+	return (true);
+}
+
+static bool
+dma_fence_array_signaled(struct dma_fence *fence)
+{
+	struct dma_fence_array *array;
+
+	array = to_dma_fence_array(fence);
+	return (atomic_read(&array->fa_pending) <= 0);
+}
+
+static void
+dma_fence_array_free_cb(struct rcu_head *rcu)
+{
+	struct dma_fence_array *array;
+
+	array = container_of(rcu, struct dma_fence_array, base.f_rcu);
+	dma_fence_destroy(&array->base);
+	spin_lock_destroy(&array->fa_lock);
+	kfree(array);
+}
+
+static void
+dma_fence_array_release(struct dma_fence *fence)
+{
+	struct dma_fence_array *array;
+	unsigned i;
+
+	array = to_dma_fence_array(fence);
+	for (i = 0; i < array->num_fences; i++)
+		dma_fence_put(array->fences[i]);
+	kfree(array->fences);
+
+	call_rcu(&array->base.f_rcu, dma_fence_array_free_cb);
+}
+
+static void
+dma_fence_array_set_deadline(struct dma_fence *fence, ktime_t deadline)
+{
+	struct dma_fence_array *array;
+	unsigned i;
+
+	array = to_dma_fence_array(fence);
+	for (i = 0; i < array->num_fences; i++)
+		dma_fence_set_deadline(array->fences[i], deadline);
+}
+
+static const struct dma_fence_ops dma_fence_array_ops = {
+	.get_driver_name = dma_fence_array_get_driver_name,
+	.get_timeline_name = dma_fence_array_get_timeline_name,
+	.enable_signaling = dma_fence_array_enable_signaling,
+	.signaled = dma_fence_array_signaled,
+	.release = dma_fence_array_release,
+	.set_deadline = dma_fence_array_set_deadline,
+};
+
+/*
+ * dma_fence_array_create(num_fences, fences, context, seqno, signal_on_any)
+ *
+ *	Create a fence that signals once all of the num_fences fences
+ *	have signalled, or once any of them has if signal_on_any is
+ *	true.  On success the array takes over fences, which must have
+ *	been allocated with kmalloc, and the references they hold.
+ *	Return NULL if memory cannot be allocated, fences then still
+ *	belong to the caller.
+ */
+struct dma_fence_array *
+dma_fence_array_create(int num_fences, struct dma_fence **fences,
+    unsigned context, unsigned seqno, bool signal_on_any)
+{
+	struct dma_fence_array *array;
+
+	MPASS(num_fences > 0);
+
+	array = kzalloc(sizeof(*array) + num_fences * sizeof(array->fa_cb[0]),
+	    GFP_KERNEL);
+	if (array == NULL)
+		return (NULL);
+
+	spin_lock_init(&array->fa_lock);
+	dma_fence_init(&array->base, &dma_fence_array_ops, &array->fa_lock,
+	    context, seqno);
+	INIT_WORK(&array->fa_signal_work, dma_fence_array_signal_work);
+
+	array->num_fences = num_fences;
+	array->fences = fences;
+	atomic_set(&array->fa_pending, signal_on_any ? 1 : num_fences);
+
+	return (array);
+}
+
+bool
+dma_fence_is_array(struct dma_fence *fence)
+{
+
+	return (fence->ops == &dma_fence_array_ops);
+}
+
+struct dma_fence_array *
+to_dma_fence_array(struct dma_fence *fence)
+{
+
+	if (fence == NULL || !dma_fence_is_array(fence))
+		return (NULL);
+
+	return (container_of(fence, struct dma_fence_array, base));
+}
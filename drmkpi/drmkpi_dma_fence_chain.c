@@ -61,6 +61,28 @@ dma_fence_chain_release(struct dma_fence *fence)
 {
 }
 
+/*
+ * Pass the deadline to the fence of every link that has not signalled
+ * yet, the chain only signals once all of them have.
+ */
+static void
+dma_fence_chain_set_deadline(struct dma_fence *fence, ktime_t deadline)
+{
+	struct dma_fence_chain *chain;
+	struct dma_fence *iter;
+
+	dma_fence_chain_for_each(iter, fence) {
+		chain = to_dma_fence_chain(iter);
+		if (chain == NULL) {
+			dma_fence_set_deadline(iter, deadline);
+			dma_fence_put(iter);
+			break;
+		}
+		if (chain->fence != NULL)
+			dma_fence_set_deadline(chain->fence, deadline);
+	}
+}
+
 const struct dma_fence_ops dma_fence_chain_ops = {
 	.use_64bit_seqno = true,
 	.get_driver_name = dma_fence_chain_get_driver_name,
@@ -68,6 +90,7 @@ const struct dma_fence_ops dma_fence_chain_ops = {
 	.enable_signaling = dma_fence_chain_enable_signaling,
 	.signaled = dma_fence_chain_signaled,
 	.release = dma_fence_chain_release,
+	.set_deadline = dma_fence_chain_set_deadline,
 };
 
 
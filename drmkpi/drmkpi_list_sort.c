@@ -31,45 +31,93 @@ __FBSDID("$FreeBSD$");
 
 #include <drmkpi/list_sort.h>
 
-MALLOC_DECLARE(M_DRMKMALLOC);
+typedef int (*list_cmp_func_t)(void *, struct list_head *, struct list_head *);
 
-struct list_sort_thunk {
-	int (*cmp)(void *, struct list_head *, struct list_head *);
-	void *priv;
-};
+/*
+ * Number of merge bins.  Bin i holds a sorted run of 2^i elements, so
+ * this covers any list that fits in memory; the last bin simply keeps
+ * absorbing runs if it is ever reached.
+ */
+#define	LIST_SORT_NBINS	32
 
-static inline int
-linux_le_cmp(void *priv, const void *d1, const void *d2)
+/*
+ * Merge two sorted, NULL-terminated runs linked through "next" only.
+ * Elements of "older" win ties, which keeps the sort stable as long as
+ * "older" holds the elements that came first in the input.
+ */
+static struct list_head *
+list_sort_merge(void *priv, list_cmp_func_t cmp, struct list_head *older,
+    struct list_head *newer)
 {
-	struct list_head *le1, *le2;
-	struct list_sort_thunk *thunk;
+	struct list_head first, *last;
 
-	thunk = priv;
-	le1 = *(__DECONST(struct list_head **, d1));
-	le2 = *(__DECONST(struct list_head **, d2));
-	return ((thunk->cmp)(thunk->priv, le1, le2));
+	last = &first;
+	while (older != NULL && newer != NULL) {
+		if (cmp(priv, newer, older) < 0) {
+			last->next = newer;
+			newer = newer->next;
+		} else {
+			last->next = older;
+			older = older->next;
+		}
+		last = last->next;
+	}
+	last->next = (older != NULL) ? older : newer;
+	return (first.next);
 }
 
+/*
+ * Stable in-place list sort with the semantics of Linux's list_sort(),
+ * implemented as a bottom-up merge sort over a binary counter of runs.
+ * Every input element enters as a run of one and is carried up through
+ * the bins, merging with each occupied bin it meets, much like adding
+ * one to a binary number.  No memory is allocated and nothing sleeps,
+ * so it may be called from any context.  The "prev" links are ignored
+ * while sorting and rebuilt in one pass at the end.
+ */
 void
 drmkpi_list_sort(void *priv, struct list_head *head, int (*cmp)(void *priv,
     struct list_head *a, struct list_head *b))
 {
-	struct list_sort_thunk thunk;
-	struct list_head **ar, *le;
-	size_t count, i;
+	struct list_head *bins[LIST_SORT_NBINS];
+	struct list_head *carry, *next, *prev, *sorted;
+	int i, nused;
+
+	if (list_empty(head) || head->next == head->prev)
+		return;
+
+	nused = 0;
+	head->prev->next = NULL;
+	for (carry = head->next; carry != NULL; carry = next) {
+		next = carry->next;
+		carry->next = NULL;
+		for (i = 0; i < nused && bins[i] != NULL; i++) {
+			carry = list_sort_merge(priv, cmp, bins[i], carry);
+			if (i == LIST_SORT_NBINS - 1)
+				break;
+			bins[i] = NULL;
+		}
+		if (i == nused)
+			nused++;
+		bins[i] = carry;
+	}
+
+	/* Higher bins hold earlier input, so they are the older side. */
+	sorted = NULL;
+	for (i = 0; i < nused; i++) {
+		if (bins[i] == NULL)
+			continue;
+		sorted = (sorted == NULL) ? bins[i] :
+		    list_sort_merge(priv, cmp, bins[i], sorted);
+	}
 
-	count = 0;
-	list_for_each(le, head)
-		count++;
-	ar = malloc(sizeof(struct list_head *) * count, M_DRMKMALLOC, M_WAITOK);
-	i = 0;
-	list_for_each(le, head)
-		ar[i++] = le;
-	thunk.cmp = cmp;
-	thunk.priv = priv;
-	qsort_r(ar, count, sizeof(struct list_head *), &thunk, linux_le_cmp);
-	INIT_LIST_HEAD(head);
-	for (i = 0; i < count; i++)
-		list_add_tail(ar[i], head);
-	free(ar, M_DRMKMALLOC);
+	/* Relink the result into head as a circular doubly-linked list. */
+	prev = head;
+	for (carry = sorted; carry != NULL; carry = carry->next) {
+		carry->prev = prev;
+		prev->next = carry;
+		prev = carry;
+	}
+	prev->next = head;
+	head->prev = prev;
 }
@@ -50,6 +50,7 @@ __FBSDID("$FreeBSD$");
 
 #include <linux/err.h>	/* For ERR_PTR */
 #include <linux/gfp.h>
+#include <linux/mm.h>
 #include <linux/slab.h>	/* For kzalloc */
 
 #include <drmkpi/fs.h>
@@ -77,6 +78,63 @@ drmkpi_free_kmem(vm_offset_t addr, unsigned int order)
 	kmem_free(addr, size);
 }
 
+/*
+ * Run the fault handler of vma for page pidx of obj, its pager object,
+ * on behalf of a populate method.  obj must be unlocked.  When
+ * VM_FAULT_NOPAGE is returned the handler has busied vm_pfn_count pages
+ * from vm_pfn_first on.
+ *
+ * A handler that had to wait for what kept it from making progress,
+ * busy pages or a fence, returns VM_FAULT_RETRY and is called again
+ * right away.  One that returns VM_FAULT_NOPAGE without any pages
+ * leaves them to a concurrent fault: sleep until a fault of the vma
+ * completes, or for a tick, rather than spin.
+ */
+int
+drmkpi_vma_fault(struct vm_area_struct *vma, vm_object_t obj,
+    vm_pindex_t pidx, int fault_type)
+{
+	struct vm_fault vmf;
+	u_int gen;
+	int err;
+
+	vmf.virtual_address = (void *)(uintptr_t)IDX_TO_OFF(pidx);
+	vmf.flags = (fault_type & VM_PROT_WRITE) ? FAULT_FLAG_WRITE : 0;
+	vmf.pgoff = 0;
+	vmf.page = NULL;
+	vmf.vma = vma;
+
+	for (;;) {
+		gen = atomic_load_int(&vma->vm_fault_gen);
+
+		vma->vm_pfn_count = 0;
+		vma->vm_pfn_pcount = &vma->vm_pfn_count;
+		vma->vm_obj = obj;
+
+		err = vma->vm_ops->fault(vma, &vmf);
+		if (err == VM_FAULT_RETRY)
+			continue;
+		if (err != VM_FAULT_NOPAGE || vma->vm_pfn_count != 0)
+			break;
+
+		VM_OBJECT_WLOCK(obj);
+		if (vma->vm_fault_gen == gen)
+			VM_OBJECT_SLEEP(obj, &vma->vm_fault_gen, PDROP,
+			    "drmflt", 1);
+		else
+			VM_OBJECT_WUNLOCK(obj);
+	}
+
+	if (err == VM_FAULT_NOPAGE) {
+		VM_OBJECT_WLOCK(obj);
+		vma->vm_fault_gen++;
+		wakeup(&vma->vm_fault_gen);
+		VM_OBJECT_WUNLOCK(obj);
+	}
+
+	return (err);
+}
+
 struct file *
 drmkpi_shmem_file_setup(const char *name, loff_t size, unsigned long flags)
 {
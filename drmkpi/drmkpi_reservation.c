@@ -437,12 +437,43 @@ reservation_object_add_excl_fence(struct reservation_object *robj,
 	}
 }
 
+/*
+ * reservation_fence_signaled_rcu(fence)
+ *
+ *	True if fence is known to have signalled.  Only the signalled
+ *	bit is read, which needs neither a reference nor the fence lock,
+ *	just an RCU read section to keep fence from being freed.  False
+ *	means the caller must reference fence and test it properly.
+ */
+static inline bool
+reservation_fence_signaled_rcu(const struct dma_fence *fence)
+{
+
+	return ((fence->flags & (1u << DMA_FENCE_FLAG_SIGNALED_BIT)) != 0);
+}
+
+/*
+ * reservation_object_shared_stale(old, fence)
+ *
+ *	True if the shared fence old can be dropped when fence is
+ *	added: it has the same context number, so fence supersedes it,
+ *	or it has already signalled.
+ */
+static bool
+reservation_object_shared_stale(struct dma_fence *old, struct dma_fence *fence)
+{
+
+	return (old->context == fence->context || dma_fence_is_signaled(old));
+}
+
 /*
  * reservation_object_add_shared_fence(robj, fence)
  *
  *	Acquire a reference to fence and add it to robj's shared list.
- *	If any fence was already added with the same context number,
- *	release it and replace it by this one.
+ *	Any fence already added with the same context number, and any
+ *	fence which has already signalled, is removed from the list and
+ *	released, so that the list does not grow with every context that
+ *	ever touched robj.
  *
  *	Caller must have robj locked, and must have preceded with a
  *	call to reservation_object_reserve_shared for each shared fence
@@ -455,8 +486,8 @@ reservation_object_add_shared_fence(struct reservation_object *robj,
 	struct reservation_object_list *list = robj->fence;
 	struct reservation_object_list *prealloc = robj->robj_prealloc;
 	struct reservation_object_write_ticket ticket;
-	struct dma_fence *replace = NULL;
-	uint32_t i;
+	struct dma_fence *old;
+	uint32_t i, j, ndrop;
 
 	MPASS(reservation_object_held(robj));
 
@@ -476,21 +507,36 @@ reservation_object_add_shared_fence(struct reservation_object *robj,
 		/* Begin an update.  Implies membar_producer for fence.  */
 		reservation_object_write_begin(robj, &ticket);
 
-		/* Find a fence with the same context number.  */
-		for (i = 0; i < list->shared_count; i++) {
-			if (list->shared[i]->context == fence->context) {
-				replace = list->shared[i];
-				list->shared[i] = fence;
-				break;
-			}
+		/*
+		 * Compact the list in place: live fences move to the
+		 * front in their original order, stale ones collect
+		 * behind them.
+		 */
+		for (i = j = 0; i < list->shared_count; i++) {
+			old = list->shared[i];
+			if (reservation_object_shared_stale(old, fence))
+				continue;
+			list->shared[i] = list->shared[j];
+			list->shared[j++] = old;
 		}
+		ndrop = list->shared_count - j;
 
-		/* If we didn't find one, add it at the end.  */
-		if (i == list->shared_count)
-			list->shared[list->shared_count++] = fence;
+		/*
+		 * Put the new fence at the end of the live ones.  The
+		 * stale fence it displaces goes to the spare slot, so
+		 * the stale ones end up in [j + 1, j + 1 + ndrop).
+		 */
+		if (ndrop != 0)
+			list->shared[list->shared_count] = list->shared[j];
+		list->shared[j] = fence;
+		list->shared_count = j + 1;
 
 		/* Commit the update.  */
 		reservation_object_write_commit(robj, &ticket);
+
+		/* Release the stale fences, now out of readers' reach.  */
+		for (i = j + 1; i < j + 1 + ndrop; i++)
+			dma_fence_put(list->shared[i]);
 	} else {
 		/*
 		 * There is a preallocated replacement list.  There may
@@ -503,23 +549,20 @@ reservation_object_add_shared_fence(struct reservation_object *robj,
 		MPASS(shared_count < prealloc->shared_max);
 
 		/*
-		 * Copy the fences over, but replace if we find one
-		 * with the same context number.
+		 * Copy the live fences over.  Stale ones are parked at
+		 * the end of the new list, past shared_count where
+		 * readers never look, until the update is committed.
 		 */
-		for (i = 0; i < shared_count; i++) {
-			if (replace == NULL &&
-			    list->shared[i]->context == fence->context) {
-				replace = list->shared[i];
-				prealloc->shared[i] = fence;
-			} else {
-				prealloc->shared[i] = list->shared[i];
-			}
+		for (i = j = ndrop = 0; i < shared_count; i++) {
+			old = list->shared[i];
+			if (reservation_object_shared_stale(old, fence))
+				prealloc->shared[prealloc->shared_max - ++ndrop] =
+				    old;
+			else
+				prealloc->shared[j++] = old;
 		}
-		prealloc->shared_count = shared_count;
-
-		/* If we didn't find one, add it at the end.  */
-		if (replace == NULL)
-			prealloc->shared[prealloc->shared_count++] = fence;
+		prealloc->shared[j] = fence;
+		prealloc->shared_count = j + 1;
 
 		/*
 		 * Now ready to replace the list.  Begin an update.
@@ -541,11 +584,14 @@ reservation_object_add_shared_fence(struct reservation_object *robj,
 		 */
 		if (list)
 			objlist_defer_free(list);
-	}
 
-	/* Release a fence if we replaced it.  */
-	if (replace)
-		dma_fence_put(replace);
+		/* Release the stale fences.  */
+		while (ndrop != 0) {
+			i = prealloc->shared_max - ndrop--;
+			dma_fence_put(prealloc->shared[i]);
+			prealloc->shared[i] = NULL;
+		}
+	}
 }
 
 /*
@@ -700,6 +746,146 @@ restart:
 	goto top;
 }
 
+/*
+ * reservation_snapshot_fini_refs(snap)
+ *
+ *	Release the references held by snap, keeping its buffer.
+ */
+static void
+reservation_snapshot_fini_refs(struct reservation_snapshot *snap)
+{
+
+	while (snap->rs_nshared != 0)
+		dma_fence_put(snap->rs_shared[--snap->rs_nshared]);
+	if (snap->rs_excl != NULL) {
+		dma_fence_put(snap->rs_excl);
+		snap->rs_excl = NULL;
+	}
+}
+
+/*
+ * reservation_object_snapshot(robj, shared, snap)
+ *
+ *	Take a consistent snapshot of the exclusive fence of robj and,
+ *	if shared is true, of its shared fences, and acquire a
+ *	reference to each.  Fences that have already signalled are left
+ *	out without being referenced.  The shared fences are stored in
+ *	the snapshot itself unless there are more than
+ *	RESERVATION_SNAPSHOT_NINLINE of them.
+ *
+ *	Return 0 on success or -ENOMEM.  On success the caller must
+ *	release the snapshot with reservation_snapshot_fini.
+ *
+ *	Note: Caller need not call this from an RCU read section.
+ */
+int
+reservation_object_snapshot(const struct reservation_object *robj,
+    bool shared, struct reservation_snapshot *snap)
+{
+	const struct reservation_object_list *list;
+	struct dma_fence *fence, **buf;
+	struct reservation_object_read_ticket ticket;
+	uint32_t i, n, shared_count;
+
+	snap->rs_excl = NULL;
+	snap->rs_shared = snap->rs_inline;
+	snap->rs_nshared = 0;
+	snap->rs_nalloc = RESERVATION_SNAPSHOT_NINLINE;
+
+top:
+	/* Enter an RCU read section and get a read ticket.  */
+	rcu_read_lock();
+	reservation_object_read_begin(robj, &ticket);
+
+	/* Copy the shared fences which are still pending.  */
+	shared_count = 0;
+	list = shared ? robj->fence : NULL;
+smp_rmb();
+	if (list) {
+		/*
+		 * The count may grow in place under us, read it once so
+		 * that the bound we check is the bound we copy.
+		 */
+		n = READ_ONCE(list->shared_count);
+		if (n > snap->rs_nalloc) {
+			/*
+			 * Too many to fit, back out of RCU and grow the
+			 * buffer.  The list may change meanwhile, the
+			 * read ticket makes us retry then.
+			 */
+			shared_count = n;
+			rcu_read_unlock();
+			buf = kcalloc(shared_count, sizeof(buf[0]),
+			    GFP_KERNEL);
+			if (buf == NULL) {
+				reservation_snapshot_fini(snap);
+				return -ENOMEM;
+			}
+			if (snap->rs_shared != snap->rs_inline)
+				kfree(snap->rs_shared);
+			snap->rs_shared = buf;
+			snap->rs_nalloc = shared_count;
+			goto top;
+		}
+		for (i = 0; i < n; i++) {
+			fence = list->shared[i];
+			if (!reservation_fence_signaled_rcu(fence))
+				snap->rs_shared[shared_count++] = fence;
+		}
+	}
+
+	/* Get the exclusive fence if it is still pending.  */
+	fence = robj->fence_excl;
+smp_rmb();
+	if (fence != NULL && reservation_fence_signaled_rcu(fence))
+		fence = NULL;
+
+	/* Make sure we saw a consistent snapshot.  */
+	if (!reservation_object_read_valid(robj, &ticket))
+		goto restart;
+
+	/*
+	 * Acquire references.  If any fence is going away, robj has
+	 * changed under us, start over.
+	 */
+	if (fence != NULL && dma_fence_get_rcu(fence) == NULL)
+		goto restart;
+	snap->rs_excl = fence;
+	for (i = 0; i < shared_count; i++) {
+		if (dma_fence_get_rcu(snap->rs_shared[i]) == NULL) {
+			snap->rs_nshared = i;
+			rcu_read_unlock();
+			reservation_snapshot_fini_refs(snap);
+			goto top;
+		}
+	}
+	snap->rs_nshared = shared_count;
+
+	rcu_read_unlock();
+	return 0;
+
+restart:
+	rcu_read_unlock();
+	goto top;
+}
+
+/*
+ * reservation_snapshot_fini(snap)
+ *
+ *	Release the fences of a snapshot taken with
+ *	reservation_object_snapshot, and any memory it allocated.
+ */
+void
+reservation_snapshot_fini(struct reservation_snapshot *snap)
+{
+
+	reservation_snapshot_fini_refs(snap);
+	if (snap->rs_shared != snap->rs_inline)
+		kfree(snap->rs_shared);
+	snap->rs_shared = snap->rs_inline;
+	snap->rs_nalloc = RESERVATION_SNAPSHOT_NINLINE;
+}
+
 /*
  * reservation_object_copy_fences(dst, src)
  *
@@ -756,7 +942,7 @@ smp_wmb();
 		dst_list->shared_count = 0;
 		for (i = 0; i < shared_count; i++) {
 			if ((fence = dma_fence_get_rcu(src_list->shared[i]))
-			    != NULL)
+			    == NULL)
 				goto restart;
 			if (dma_fence_is_signaled(fence)) {
 				dma_fence_put(fence);
@@ -906,6 +1092,8 @@ smp_wmb();
 		 * signalled.
 		 */
 		for (i = 0; i < shared_count; i++) {
+			if (reservation_fence_signaled_rcu(list->shared[i]))
+				continue;
 			fence = dma_fence_get_rcu(list->shared[i]);
 			if (fence == NULL)
 				goto restart;
@@ -914,6 +1102,13 @@ smp_wmb();
 			if (!signaled)
 				goto out;
 		}
+
+		/*
+		 * Entries may move within the list while we walk it,
+		 * make sure we did not skip a pending one.
+		 */
+		if (!reservation_object_read_valid(robj, &ticket))
+			goto restart;
 	}
 
 excl:
@@ -935,6 +1130,10 @@ smp_wmb();
 		if (!reservation_object_read_valid(robj, &ticket))
 			goto restart;
 
+		/* Nothing more to do if it is known to be signalled.  */
+		if (reservation_fence_signaled_rcu(fence))
+			goto out;
+
 		/*
 		 * If it is going away, restart.  Otherwise, acquire a
 		 * reference to it to test whether it is signalled.
@@ -972,109 +1171,36 @@ long
 reservation_object_wait_timeout_rcu(const struct reservation_object *robj,
     bool shared, bool intr, unsigned long timeout)
 {
-	struct reservation_object_read_ticket ticket;
-	struct reservation_object_list *list;
+	struct reservation_snapshot snap;
 	struct dma_fence *fence;
-	uint32_t i, shared_count;
+	unsigned i;
 	long ret;
 
 	if (timeout == 0)
 		return reservation_object_test_signaled_rcu(robj, shared);
 
-top:
-	/* Enter an RCU read section and get a read ticket.  */
-	rcu_read_lock();
-	reservation_object_read_begin(robj, &ticket);
-
-	/* If shared is requested and there is a shared list, wait on it.  */
-	if (!shared)
-		goto excl;
-	list = robj->fence;
-//	__insn_barrier();
-smp_rmb();
-	if (list) {
-		/* Make sure the content of the list has been published.  */
-//		membar_datadep_consumer();
-smp_wmb();
-
-		/* Find out how long it is.  */
-		shared_count = list->shared_count;
-
-		/*
-		 * Make sure we saw a consistent snapshot of the list
-		 * pointer and length.
-		 */
-		if (!reservation_object_read_valid(robj, &ticket))
-			goto restart;
-
-		/*
-		 * For each fence, if it is going away, restart.
-		 * Otherwise, acquire a reference to it to test whether
-		 * it is signalled.  Stop and wait if we find any that
-		 * is not signalled.
-		 */
-		for (i = 0; i < shared_count; i++) {
-			fence = dma_fence_get_rcu(list->shared[i]);
-			if (fence == NULL)
-				goto restart;
-			if (!dma_fence_is_signaled(fence))
-				goto wait;
-			dma_fence_put(fence);
-		}
-	}
-
-excl:
-	/* If there is an exclusive fence, test it.  */
-	fence = robj->fence_excl;
-smp_rmb();
-//	__insn_barrier();
-	if (fence) {
-		/* Make sure the content of the fence has been published.  */
-//		membar_datadep_consumer();
-smp_wmb();
-
-		/*
-		 * Make sure we saw a consistent snapshot of the fence.
-		 *
-		 * XXX I'm not actually sure this is necessary since
-		 * pointer writes are supposed to be atomic.
-		 */
-		if (!reservation_object_read_valid(robj, &ticket))
-			goto restart;
+	/*
+	 * Wait on a snapshot of the pending fences, without allocating
+	 * in the common case of a few of them.
+	 */
+	ret = reservation_object_snapshot(robj, shared, &snap);
+	if (ret != 0)
+		return ret;
 
-		/*
-		 * If it is going away, restart.  Otherwise, acquire a
-		 * reference to it to test whether it is signalled.  If
-		 * not, wait for it.
-		 */
-		if ((fence = dma_fence_get_rcu(fence)) == NULL)
-			goto restart;
-		if (!dma_fence_is_signaled(fence))
-			goto wait;
-		dma_fence_put(fence);
+	ret = timeout;
+	for (i = 0; i <= snap.rs_nshared; i++) {
+		fence = i < snap.rs_nshared ? snap.rs_shared[i] : snap.rs_excl;
+		if (fence == NULL)
+			continue;
+		ret = dma_fence_wait_timeout(fence, intr, ret);
+		if (ret <= 0)
+			break;
+		MPASS(ret <= timeout);
 	}
+	reservation_snapshot_fini(&snap);
 
 	/* Success!  Return the number of ticks left.  */
-	rcu_read_unlock();
-	return timeout;
-
-restart:
-	rcu_read_unlock();
-	goto top;
-
-wait:
-	/*
-	 * Exit the RCU read section and wait for it.  If we time out
-	 * or fail, bail.  Otherwise, go back to the top.
-	 */
-	MPASS(fence != NULL);
-	rcu_read_unlock();
-	ret = dma_fence_wait_timeout(fence, intr, timeout);
-	if (ret <= 0)
-		return ret;
-	MPASS(ret <= timeout);
-	timeout = ret;
-	goto top;
+	return ret;
 }
 
 /*
@@ -1196,6 +1322,8 @@ smp_wmb();
 		 * find any that is not signalled.
 		 */
 		for (i = 0; i < shared_count; i++) {
+			if (reservation_fence_signaled_rcu(list->shared[i]))
+				continue;
 			fence = dma_fence_get_rcu(list->shared[i]);
 			if (fence == NULL)
 				goto restart;
@@ -1206,9 +1334,15 @@ smp_wmb();
 			dma_fence_put(fence);
 		}
 
-		/* If all shared fences have been signalled, move on.  */
-		if (i == shared_count)
+		/*
+		 * If all shared fences have been signalled, move on,
+		 * unless entries moved while we walked the list.
+		 */
+		if (i == shared_count) {
+			if (!reservation_object_read_valid(robj, &ticket))
+				goto restart;
 			break;
+		}
 
 		/* Put ourselves on the selq if we haven't already.  */
 		if (!recorded)
@@ -1265,6 +1399,10 @@ smp_wmb();
 		if (!reservation_object_read_valid(robj, &ticket))
 			goto restart;
 
+		/* Nothing to wait for if it is known to be signalled.  */
+		if (reservation_fence_signaled_rcu(fence))
+			break;
+
 		/*
 		 * If it is going away, restart.  Otherwise, acquire a
 		 * reference to it to test whether it is signalled.  If
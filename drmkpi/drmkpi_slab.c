@@ -31,11 +31,29 @@ __FBSDID("$FreeBSD$");
 #include <linux/rcupdate.h>
 #include <linux/kernel.h>
 
+/*
+ * SLAB_TYPESAFE_BY_RCU caches.
+ *
+ * An object of such a cache may only be handed out again once every RCU
+ * reader that might still be looking at it is gone.  Rather than queueing
+ * one RCU callback per object, freed objects are collected on a per-cache
+ * list and handed to call_rcu() in batches: the callback receives the head
+ * of the batch and returns the whole list to the zone.  The list linkage
+ * lives in a trailer appended to each object, so readers never see it.
+ * A batch may hold back up to DRMKPI_KMEM_RCU_BATCH - 1 objects until the
+ * next free or the cache is destroyed.
+ *
+ * Since objects are only reused after a grace period, the constructor can
+ * run on every allocation, as for other caches.
+ */
 struct drmkpi_kmem_rcu {
 	struct rcu_head rcu_head;
 	struct drmkpi_kmem_cache *cache;
+	void *next;
 };
 
+#define	DRMKPI_KMEM_RCU_BATCH	32
+
 #define	LINUX_KMEM_TO_RCU(c, m)					\
 	((struct drmkpi_kmem_rcu *)((char *)(m) +		\
 	(c)->cache_size - sizeof(struct drmkpi_kmem_rcu)))
@@ -44,32 +62,27 @@ struct drmkpi_kmem_rcu {
 	((void *)((char *)(r) + sizeof(struct drmkpi_kmem_rcu) - \
 	(r)->cache->cache_size))
 
-static int
-drmkpi_kmem_ctor(void *mem, int size, void *arg, int flags)
+static void
+drmkpi_kmem_cache_free_rcu_callback(struct rcu_head *head)
 {
-	struct drmkpi_kmem_cache *c = arg;
-
-	if (unlikely(c->cache_flags & SLAB_TYPESAFE_BY_RCU)) {
-		struct drmkpi_kmem_rcu *rcu = LINUX_KMEM_TO_RCU(c, mem);
+	struct drmkpi_kmem_rcu *rcu =
+	    container_of(head, struct drmkpi_kmem_rcu, rcu_head);
+	struct drmkpi_kmem_cache *c = rcu->cache;
+	void *m, *next;
 
-		/* duplicate cache pointer */
-		rcu->cache = c;
+	for (m = LINUX_RCU_TO_KMEM(rcu); m != NULL; m = next) {
+		next = LINUX_KMEM_TO_RCU(c, m)->next;
+		uma_zfree(c->cache_zone, m);
 	}
-
-	/* check for constructor */
-	if (likely(c->cache_ctor != NULL))
-		c->cache_ctor(mem);
-
-	return (0);
 }
 
 static void
-drmkpi_kmem_cache_free_rcu_callback(struct rcu_head *head)
+drmkpi_kmem_cache_queue_rcu(struct drmkpi_kmem_cache *c, void *batch)
 {
-	struct drmkpi_kmem_rcu *rcu =
-	    container_of(head, struct drmkpi_kmem_rcu, rcu_head);
+	struct drmkpi_kmem_rcu *rcu = LINUX_KMEM_TO_RCU(c, batch);
 
-	uma_zfree(rcu->cache->cache_zone, LINUX_RCU_TO_KMEM(rcu));
+	rcu->cache = c;
+	call_rcu(&rcu->rcu_head, drmkpi_kmem_cache_free_rcu_callback);
 }
 
 struct drmkpi_kmem_cache *
@@ -78,7 +91,7 @@ drmkpi_kmem_cache_create(const char *name, size_t size, size_t align,
 {
 	struct drmkpi_kmem_cache *c;
 
-	c = malloc(sizeof(*c), M_DRMKMALLOC, M_WAITOK);
+	c = malloc(sizeof(*c), M_DRMKMALLOC, M_WAITOK | M_ZERO);
 
 	if (flags & SLAB_HWCACHE_ALIGN)
 		align = UMA_ALIGN_CACHE;
@@ -86,21 +99,16 @@ drmkpi_kmem_cache_create(const char *name, size_t size, size_t align,
 		align--;
 
 	if (flags & SLAB_TYPESAFE_BY_RCU) {
-		/* make room for RCU structure */
+		/* make room for the RCU trailer */
 		size = ALIGN(size, sizeof(void *));
 		size += sizeof(struct drmkpi_kmem_rcu);
-
-		/* create cache_zone */
-		c->cache_zone = uma_zcreate(name, size,
-		    drmkpi_kmem_ctor, NULL, NULL, NULL,
-		    align, UMA_ZONE_ZINIT);
-	} else {
-		/* create cache_zone */
-		c->cache_zone = uma_zcreate(name, size,
-		    ctor ? drmkpi_kmem_ctor : NULL, NULL,
-		    NULL, NULL, align, 0);
+		mtx_init(&c->cache_rcu_mtx, "drmkpi_kmem_rcu", NULL, MTX_DEF);
 	}
 
+	/* create cache_zone */
+	c->cache_zone = uma_zcreate(name, size, NULL, NULL, NULL, NULL,
+	    align, 0);
+
 	c->cache_flags = flags;
 	c->cache_ctor = ctor;
 	c->cache_size = size;
@@ -110,17 +118,40 @@ drmkpi_kmem_cache_create(const char *name, size_t size, size_t align,
 void
 drmkpi_kmem_cache_free_rcu(struct drmkpi_kmem_cache *c, void *m)
 {
-	struct drmkpi_kmem_rcu *rcu = LINUX_KMEM_TO_RCU(c, m);
+	void *batch = NULL;
+
+	mtx_lock(&c->cache_rcu_mtx);
+	LINUX_KMEM_TO_RCU(c, m)->next = c->cache_rcu_pending;
+	c->cache_rcu_pending = m;
+	if (++c->cache_rcu_count == DRMKPI_KMEM_RCU_BATCH) {
+		batch = c->cache_rcu_pending;
+		c->cache_rcu_pending = NULL;
+		c->cache_rcu_count = 0;
+	}
+	mtx_unlock(&c->cache_rcu_mtx);
 
-	call_rcu(&rcu->rcu_head, drmkpi_kmem_cache_free_rcu_callback);
+	if (batch != NULL)
+		drmkpi_kmem_cache_queue_rcu(c, batch);
 }
 
 void
 drmkpi_kmem_cache_destroy(struct drmkpi_kmem_cache *c)
 {
+	void *batch;
+
 	if (unlikely(c->cache_flags & SLAB_TYPESAFE_BY_RCU)) {
+		mtx_lock(&c->cache_rcu_mtx);
+		batch = c->cache_rcu_pending;
+		c->cache_rcu_pending = NULL;
+		c->cache_rcu_count = 0;
+		mtx_unlock(&c->cache_rcu_mtx);
+
+		if (batch != NULL)
+			drmkpi_kmem_cache_queue_rcu(c, batch);
+
 		/* make sure all free callbacks have been called */
 		rcu_barrier();
+		mtx_destroy(&c->cache_rcu_mtx);
 	}
 
 	uma_zdestroy(c->cache_zone);
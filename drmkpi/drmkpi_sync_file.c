@@ -126,23 +126,48 @@ syncfile_fop_close(struct file *file, struct thread *td)
 	if (test_bit(POLL_ENABLED, &sf->flags))
 		dma_fence_remove_callback(sf->fence, &sf->cb);
 	dma_fence_put(sf->fence);
+	seldrain(&sf->sf_selq);
 
 	free(sf, M_SYNCFILE);
 	return (0);
 }
 
+static void
+syncfile_fence_cb(struct dma_fence *fence, struct dma_fence_cb *cb)
+{
+	struct sync_file *sf;
+
+	sf = container_of(cb, struct sync_file, cb);
+	selwakeup(&sf->sf_selq);
+}
+
 static int
 syncfile_fop_poll(struct file *file, int events, struct ucred *active_cred,
     struct thread *td)
 {
 	struct sync_file *sf;
+	int revents;
 
 	if (!file_is_syncfile(file))
 		return (EINVAL);
 	sf = file->f_data;
-	panic("Implement %s", __func__);
 
-	return (dma_fence_is_signaled(sf->fence) ? POLLIN : 0);
+	revents = events & (POLLIN | POLLRDNORM);
+	if (revents == 0)
+		return (0);
+
+	if (!test_and_set_bit(POLL_ENABLED, &sf->flags))
+		(void)dma_fence_add_callback(sf->fence, &sf->cb,
+		    syncfile_fence_cb);
+	if (dma_fence_is_signaled(sf->fence))
+		return (revents);
+
+	selrecord(td, &sf->sf_selq);
+	/* The fence may have signalled before we were recorded. */
+	if (dma_fence_is_signaled(sf->fence))
+		return (revents);
+
+	return (0);
 }
 
 static int
@@ -28,6 +28,8 @@
 #ifndef _DRM_GEM_CMA_H_
 #define	_DRM_GEM_CMA_H_
 
+#include <linux/dma-mapping.h>
+
 #include <drm/drm_gem.h>
 
 struct drm_gem_cma_object {
@@ -39,6 +41,7 @@ struct drm_gem_cma_object {
 	size_t			npages;
 	size_t			size;		/* Rounded to page */
 	vm_page_t 		*m;
+	vm_memattr_t		memattr;	/* Of kernel and user mappings */
 };
 
 int drm_gem_cma_create(struct drm_device *drm, size_t size,
@@ -49,6 +52,14 @@ int drm_gem_cma_dumb_create(struct drm_file *file, struct drm_device *drm_dev,
 int drm_gem_cma_mmap(struct file *file, struct vm_area_struct *vma);
 vm_page_t * drm_gem_cma_get_pages(struct drm_gem_object *gem_obj,
     int *npages);
+void drm_gem_cma_flush(struct drm_gem_cma_object *bo, unsigned long offset,
+    unsigned long len);
+vm_offset_t drm_gem_cma_map_kernel(struct drm_gem_cma_object *bo);
+void drm_gem_cma_unmap_kernel(struct drm_gem_cma_object *bo, vm_offset_t va);
+int drm_gem_cma_prime_begin_cpu_access(struct drm_gem_object *gem_obj,
+    enum dma_data_direction dir, unsigned long offset, unsigned long len);
+int drm_gem_cma_prime_end_cpu_access(struct drm_gem_object *gem_obj,
+    enum dma_data_direction dir, unsigned long offset, unsigned long len);
 
 extern const struct vm_operations_struct drm_gem_cma_vm_ops;
 
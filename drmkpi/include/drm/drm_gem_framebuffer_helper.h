@@ -1,8 +1,15 @@
 #ifndef __DRM_GEM_FB_HELPER_H__
 #define __DRM_GEM_FB_HELPER_H__
 
+struct drm_plane;
+struct drm_plane_state;
+
 struct drm_framebuffer *
 drm_gem_fb_create(struct drm_device *drm, struct drm_file *file,
     const struct drm_mode_fb_cmd2 *cmd);
+int drm_gem_fb_prepare_fb(struct drm_plane *plane,
+    struct drm_plane_state *state);
+int drm_gem_fb_flush_prepare_fb(struct drm_plane *plane,
+    struct drm_plane_state *state);
 
 #endif
@@ -31,8 +31,12 @@ MALLOC_DECLARE(DRM_MEM_KMS);
 
 struct drm_minor;
 struct drm_device;
+struct file;
+struct vm_area_struct;
 int drm_fbsd_cdev_create(struct drm_minor *minor);
 void drm_fbsd_cdev_delete(struct drm_minor *minor);
+struct file *drm_fbsd_file_clone(struct file *file);
+int drm_fbsd_vma_backing_object(struct vm_area_struct *vma);
 int drm_fbsd_sysctl_cleanup(struct drm_device *dev);
 int drm_fbsd_sysctl_init(struct drm_device *dev);
 
@@ -43,6 +43,7 @@ struct dma_buf;
 struct dma_buf_attachment;
 struct dma_buf_export_info;
 struct dma_buf_ops;
+struct dma_buf_pager;
 struct file;
 struct module;
 struct reservation_object;
@@ -61,6 +62,10 @@ struct dma_buf_ops {
 	void	(*release)(struct dma_buf *);
 	int	(*begin_cpu_access)(struct dma_buf *, enum dma_data_direction);
 	int	(*end_cpu_access)(struct dma_buf *, enum dma_data_direction);
+	int	(*begin_cpu_access_partial)(struct dma_buf *,
+		    enum dma_data_direction, unsigned long, unsigned long);
+	int	(*end_cpu_access_partial)(struct dma_buf *,
+		    enum dma_data_direction, unsigned long, unsigned long);
 	void *	(*map)(struct dma_buf *, unsigned long);
 	void	(*unmap)(struct dma_buf *, unsigned long, void *);
 	int	(*mmap)(struct dma_buf *, struct vm_area_struct *vma);
@@ -76,6 +81,7 @@ struct dma_buf {
 
 	struct file 			*db_file;
 	struct sx			db_sx;
+	struct dma_buf_pager		*db_pager;
 	struct reservation_poll		db_resv_poll;
 	struct reservation_object	db_resv_int[];
 };
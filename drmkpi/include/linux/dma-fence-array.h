@@ -34,14 +34,36 @@
 
 #include <sys/types.h>
 
+#include <linux/atomic.h>
+#include <linux/dma-fence.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#define	dma_fence_array_create		linux_dma_fence_array_create
 #define	dma_fence_is_array		linux_dma_fence_is_array
 #define	to_dma_fence_array		linux_to_dma_fence_array
 
+struct dma_fence_array;
+
+struct dma_fence_array_cb {
+	struct dma_fence_cb		cb;
+	struct dma_fence_array		*array;
+};
+
 struct dma_fence_array {
-	struct dma_fence	**fences;
-	unsigned		num_fences;
+	struct dma_fence		base;
+	struct dma_fence		**fences;
+	unsigned			num_fences;
+
+	spinlock_t			fa_lock;
+	atomic_t			fa_pending;
+	struct work_struct		fa_signal_work;
+	struct dma_fence_array_cb	fa_cb[];
 };
 
+struct dma_fence_array *
+	dma_fence_array_create(int, struct dma_fence **, unsigned, unsigned,
+	    bool);
 bool	dma_fence_is_array(struct dma_fence *);
 struct dma_fence_array *
 	to_dma_fence_array(struct dma_fence *);
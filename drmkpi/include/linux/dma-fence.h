@@ -39,6 +39,7 @@
 #include <sys/queue.h>
 
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/mutex.h>
 #include <linux/rcupdate.h>
 #include <linux/spinlock.h>
@@ -75,6 +76,7 @@ struct dma_fence_ops {
 	bool		(*signaled)(struct dma_fence *);
 	long		(*wait)(struct dma_fence *, bool, long);
 	void		(*release)(struct dma_fence *);
+	void		(*set_deadline)(struct dma_fence *, ktime_t);
 };
 
 typedef void (*dma_fence_func_t)(struct dma_fence *, struct dma_fence_cb *);
@@ -100,6 +102,7 @@ struct dma_fence_cb {
 #define	dma_fence_is_signaled_locked	linux_dma_fence_is_signaled_locked
 #define	dma_fence_put			linux_dma_fence_put
 #define	dma_fence_remove_callback	linux_dma_fence_remove_callback
+#define	dma_fence_set_deadline		linux_dma_fence_set_deadline
 #define	dma_fence_set_error		linux_dma_fence_set_error
 #define	dma_fence_signal		linux_dma_fence_signal
 #define	dma_fence_signal_locked		linux_dma_fence_signal_locked
@@ -133,6 +136,7 @@ void	dma_fence_enable_sw_signaling(struct dma_fence *);
 
 bool	dma_fence_is_signaled(struct dma_fence *);
 bool	dma_fence_is_signaled_locked(struct dma_fence *);
+void	dma_fence_set_deadline(struct dma_fence *, ktime_t);
 void	dma_fence_set_error(struct dma_fence *, int);
 int	dma_fence_signal(struct dma_fence *);
 int	dma_fence_signal_locked(struct dma_fence *);
@@ -112,6 +112,8 @@ struct vm_area_struct {
 	int	vm_pfn_count;
 	int    *vm_pfn_pcount;
 	vm_object_t vm_obj;
+	vm_object_t vm_backing_obj;	/* object to map, referenced */
+	u_int	vm_fault_gen;		/* completed faults, drmkpi_vma_fault() */
 	vm_map_t vm_cached_map;
 	TAILQ_ENTRY(vm_area_struct) vm_entry;
 };
@@ -135,6 +137,9 @@ struct vm_operations_struct {
 	int	(*access) (struct vm_area_struct *, unsigned long, void *, int, int);
 };
 
+int drmkpi_vma_fault(struct vm_area_struct *vma, vm_object_t obj,
+    vm_pindex_t pidx, int fault_type);
+
 struct sysinfo {
 	uint64_t totalram;
 	uint64_t totalhigh;
@@ -62,6 +62,21 @@ struct reservation_poll {
 	bool			rp_claimed;
 };
 
+/*
+ * Snapshot of the unsignalled fences of a reservation object.  Up to
+ * RESERVATION_SNAPSHOT_NINLINE shared fences are kept in the snapshot
+ * itself, so the common case takes no allocation.
+ */
+#define	RESERVATION_SNAPSHOT_NINLINE	4
+
+struct reservation_snapshot {
+	struct dma_fence	*rs_excl;
+	struct dma_fence	**rs_shared;
+	unsigned		rs_nshared;
+	unsigned		rs_nalloc;
+	struct dma_fence	*rs_inline[RESERVATION_SNAPSHOT_NINLINE];
+};
+
 #define	reservation_object_add_excl_fence	linux_reservation_object_add_excl_fence
 #define	reservation_object_add_shared_fence	linux_reservation_object_add_shared_fence
 #define	reservation_object_assert_held		linux_reservation_object_assert_held
@@ -78,12 +93,14 @@ struct reservation_poll {
 #define	reservation_object_lock_interruptible	linux_reservation_object_lock_interruptible
 #define	reservation_object_poll			linux_reservation_object_poll
 #define	reservation_object_reserve_shared	linux_reservation_object_reserve_shared
+#define	reservation_object_snapshot		linux_reservation_object_snapshot
 #define	reservation_object_test_signaled_rcu	linux_reservation_object_test_signaled_rcu
 #define	reservation_object_trylock		linux_reservation_object_trylock
 #define	reservation_object_unlock		linux_reservation_object_unlock
 #define	reservation_object_wait_timeout_rcu	linux_reservation_object_wait_timeout_rcu
 #define	reservation_poll_fini			linux_reservation_poll_fini
 #define	reservation_poll_init			linux_reservation_poll_init
+#define	reservation_snapshot_fini		linux_reservation_snapshot_fini
 #define	reservation_ww_class			linux_reservation_ww_class
 
 extern struct ww_class	reservation_ww_class;
@@ -116,6 +133,11 @@ int	reservation_object_get_fences_rcu(const struct reservation_object *,
 int	reservation_object_copy_fences(struct reservation_object *,
 	    const struct reservation_object *);
 
+/* FreeBSD additions */
+int	reservation_object_snapshot(const struct reservation_object *, bool,
+	    struct reservation_snapshot *);
+void	reservation_snapshot_fini(struct reservation_snapshot *);
+
 bool	reservation_object_test_signaled_rcu(const struct reservation_object *,
 	    bool);
 long	reservation_object_wait_timeout_rcu(const struct reservation_object *,
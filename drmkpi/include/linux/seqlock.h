@@ -37,6 +37,7 @@
 #include <sys/mutex.h>
 
 #include <machine/atomic.h>
+#include <machine/cpu.h>
 
 #include <linux/preempt.h>
 #include <linux/lockdep.h>
@@ -62,13 +63,18 @@ seqcount_destroy(struct seqcount *seqcount)
 	seqcount->sqc_gen = -1;
 }
 
+/*
+ * Writers are serialized by the caller. The barriers follow sys/seqc.h: the
+ * odd generation must be visible before the protected data is modified, and
+ * the data before the generation is made even again.
+ */
 static inline void
 write_seqcount_begin(struct seqcount *seqcount)
 {
 
 	MPASS((seqcount->sqc_gen & 1) == 0);
-	seqcount->sqc_gen |= 1;
-//	membar_producer();
+	atomic_store_int(&seqcount->sqc_gen, seqcount->sqc_gen + 1);
+	atomic_thread_fence_rel();
 }
 
 static inline void
@@ -76,9 +82,7 @@ write_seqcount_end(struct seqcount *seqcount)
 {
 
 	MPASS((seqcount->sqc_gen & 1) == 1);
-//	membar_producer();
-	seqcount->sqc_gen |= 1;	/* paranoia */
-	seqcount->sqc_gen++;
+	atomic_store_rel_int(&seqcount->sqc_gen, seqcount->sqc_gen + 1);
 }
 
 static inline unsigned
@@ -86,10 +90,10 @@ __read_seqcount_begin(const struct seqcount *seqcount)
 {
 	unsigned gen;
 
-	while (__predict_false((gen = seqcount->sqc_gen) & 1))
-;
-//		SPINLOCK_BACKOFF_HOOK;
-//	__insn_barrier();
+	while (__predict_false((gen =
+	    atomic_load_int(__DECONST(volatile u_int *, &seqcount->sqc_gen))) &
+	    1))
+		cpu_spinwait();
 
 	return gen;
 }
@@ -98,8 +102,8 @@ static inline bool
 __read_seqcount_retry(const struct seqcount *seqcount, unsigned gen)
 {
 
-//	__insn_barrier();
-	return __predict_false(seqcount->sqc_gen != gen);
+	return __predict_false(atomic_load_int(
+	    __DECONST(volatile u_int *, &seqcount->sqc_gen)) != gen);
 }
 
 static inline unsigned
@@ -108,7 +112,7 @@ read_seqcount_begin(const struct seqcount *seqcount)
 	unsigned gen;
 
 	gen = __read_seqcount_begin(seqcount);
-//	membar_consumer();
+	atomic_thread_fence_acq();
 
 	return gen;
 }
@@ -117,7 +121,7 @@ static inline bool
 read_seqcount_retry(const struct seqcount *seqcount, unsigned gen)
 {
 
-//	membar_consumer();
+	atomic_thread_fence_acq();
 	return __read_seqcount_retry(seqcount, gen);
 }
 
@@ -126,8 +130,8 @@ raw_read_seqcount(const struct seqcount *seqcount)
 {
 	unsigned gen;
 
-	gen = seqcount->sqc_gen;
-//	membar_consumer();
+	gen = atomic_load_int(__DECONST(volatile u_int *, &seqcount->sqc_gen));
+	atomic_thread_fence_acq();
 
 	return gen;
 }
@@ -144,7 +148,7 @@ seqlock_init(struct seqlock *seqlock)
 {
 
 	mtx_init(&seqlock->sql_lock, "seqlock", NULL, MTX_DEF);
-//	seqcount_init(&seqlock->sql_count);
+	seqcount_init(&seqlock->sql_count);
 }
 
 static inline void
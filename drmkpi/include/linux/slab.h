@@ -36,6 +36,8 @@
 #include <sys/systm.h>
 #include <sys/malloc.h>
 #include <sys/limits.h>
+#include <sys/lock.h>
+#include <sys/mutex.h>
 #include <vm/uma.h>
 
 #include <linux/types.h>
@@ -79,6 +81,11 @@ struct drmkpi_kmem_cache {
 	drmkpi_kmem_ctor_t *cache_ctor;
 	unsigned cache_flags;
 	unsigned cache_size;
+
+	/* SLAB_TYPESAFE_BY_RCU: frees waiting to be queued to RCU */
+	struct mtx cache_rcu_mtx;
+	void *cache_rcu_pending;
+	unsigned cache_rcu_count;
 };
 
 #define	SLAB_HWCACHE_ALIGN	(1 << 0)
@@ -167,15 +174,22 @@ extern struct drmkpi_kmem_cache *drmkpi_kmem_cache_create(const char *name,
 static inline void *
 drmkpi_kmem_cache_alloc(struct drmkpi_kmem_cache *c, gfp_t flags)
 {
-	return (uma_zalloc_arg(c->cache_zone, c,
-	    linux_check_m_flags(flags)));
+	void *m;
+
+	/*
+	 * The constructor is run here rather than as the UMA constructor,
+	 * which UMA would run before zero-filling for kmem_cache_zalloc().
+	 */
+	m = uma_zalloc(c->cache_zone, linux_check_m_flags(flags));
+	if (m != NULL && c->cache_ctor != NULL)
+		c->cache_ctor(m);
+	return (m);
 }
 
 static inline void *
 kmem_cache_zalloc(struct drmkpi_kmem_cache *c, gfp_t flags)
 {
-	return (uma_zalloc_arg(c->cache_zone, c,
-	    linux_check_m_flags(flags | M_ZERO)));
+	return (drmkpi_kmem_cache_alloc(c, flags | __GFP_ZERO));
 }
 
 extern void drmkpi_kmem_cache_free_rcu(struct drmkpi_kmem_cache *, void *);
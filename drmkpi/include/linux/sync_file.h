@@ -3,6 +3,7 @@
 
 #include <sys/types.h>
 #include <sys/mutex.h>
+#include <sys/selinfo.h>
 
 #include <linux/dma-fence.h>
 
@@ -14,6 +15,7 @@ struct sync_file {
 	struct dma_fence_cb	cb;
 
 	struct file		*sf_file;
+	struct selinfo		sf_selq;
 };
 
 #define POLL_ENABLED 0
@@ -0,0 +1,123 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Boot timeline: time stamps of the steps between DRM attach and the first
+ * frame reaching the screen, exported as dev.drm.boot_timeline so that
+ * time-to-first-frame can be measured. Only the first events are kept, once
+ * the buffer is full later events are dropped.
+ */
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/bus.h>
+#include <sys/kernel.h>
+#include <sys/lock.h>
+#include <sys/mutex.h>
+#include <sys/sbuf.h>
+#include <sys/sysctl.h>
+
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+
+#include <drm/drm_boot_timeline.h>
+#include <drm/drm_device.h>
+
+#define	DRM_BOOT_TIMELINE_SIZE	64
+
+struct drm_boot_entry {
+	ktime_t			time;
+	struct drm_device	*dev;
+	enum drm_boot_event	event;
+	char			devname[16];
+	char			what[32];
+};
+
+static const char *drm_boot_event_names[] = {
+	[DRM_BOOT_PROBE_START] =	"probe_start",
+	[DRM_BOOT_PROBE_END] =		"probe_end",
+	[DRM_BOOT_FIRST_MODESET] =	"first_modeset",
+	[DRM_BOOT_FIRST_FBDEV] =	"first_fbdev",
+};
+
+static struct drm_boot_entry drm_boot_timeline[DRM_BOOT_TIMELINE_SIZE];
+static int drm_boot_timeline_count;
+
+static struct mtx drm_boot_timeline_mtx;
+MTX_SYSINIT(drm_boot_timeline, &drm_boot_timeline_mtx, "drmbtl", MTX_DEF);
+
+static bool
+drm_boot_event_is_first(enum drm_boot_event event)
+{
+
+	return (event == DRM_BOOT_FIRST_MODESET ||
+	    event == DRM_BOOT_FIRST_FBDEV);
+}
+
+void
+drm_boot_timeline_record(struct drm_device *dev, enum drm_boot_event event,
+    const char *what)
+{
+	struct drm_boot_entry *e;
+	ktime_t now;
+	int i;
+
+	now = ktime_get();
+
+	mtx_lock(&drm_boot_timeline_mtx);
+	if (drm_boot_timeline_count == DRM_BOOT_TIMELINE_SIZE)
+		goto out;
+	if (drm_boot_event_is_first(event)) {
+		for (i = 0; i < drm_boot_timeline_count; i++) {
+			e = &drm_boot_timeline[i];
+			if (e->dev == dev && e->event == event)
+				goto out;
+		}
+	}
+
+	e = &drm_boot_timeline[drm_boot_timeline_count++];
+	e->time = now;
+	e->dev = dev;
+	e->event = event;
+	strlcpy(e->devname, device_get_nameunit(dev->dev), sizeof(e->devname));
+	strlcpy(e->what, what != NULL ? what : "-", sizeof(e->what));
+out:
+	mtx_unlock(&drm_boot_timeline_mtx);
+}
+
+static int
+drm_boot_timeline_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_boot_entry *e;
+	struct sbuf sb;
+	int error, i;
+
+	error = sysctl_wire_old_buffer(req, 0);
+	if (error != 0)
+		return (error);
+
+	sbuf_new_for_sysctl(&sb, NULL, 128, req);
+	mtx_lock(&drm_boot_timeline_mtx);
+	for (i = 0; i < drm_boot_timeline_count; i++) {
+		e = &drm_boot_timeline[i];
+		sbuf_printf(&sb, "\n%12jd us %s %s %s",
+		    (intmax_t)ktime_to_us(e->time), e->devname,
+		    drm_boot_event_names[e->event], e->what);
+	}
+	mtx_unlock(&drm_boot_timeline_mtx);
+	error = sbuf_finish(&sb);
+	sbuf_delete(&sb);
+
+	return (error);
+}
+
+SYSCTL_PROC(_dev_drm, OID_AUTO, boot_timeline,
+    CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_MPSAFE, NULL, 0,
+    drm_boot_timeline_sysctl, "A",
+    "Time since boot of DRM probe and first frame events");
@@ -39,19 +39,36 @@ __FBSDID("$FreeBSD$");
 #include <vm/vm_object.h>
 #include <vm/vm_page.h>
 #include <vm/vm_pageout.h>
+#include <vm/vm_param.h>
 #include <vm/vm_pager.h>
 
 #include <machine/bus.h>
 
 #include <dev/extres/clk/clk.h>
 
+#include <linux/moduleparam.h>
+
+#include <drm/drm_cache.h>
 #include <drm/drm_crtc_helper.h>
 #include <drm/drm_gem.h>
 #include <drm/drm_gem_cma_helper.h>
 
+/*
+ * Dumb buffers are write-combined unless dev.drm.cma_cached is set. Cached
+ * buffers are cleaned to memory by the framebuffer helpers, for the damage
+ * of each commit and dirtyfb call; anything written to a scanned out buffer
+ * without either may not reach the screen.
+ */
+static bool drm_gem_cma_cached = false;
+MODULE_PARM_DESC(cma_cached,
+    "Map CMA dumb buffers cached, scanout is kept coherent on commit/dirtyfb");
+module_param_named(cma_cached, drm_gem_cma_cached, bool, 0600);
+
 static int
 drm_gem_cma_create_with_handle(struct drm_file *file, struct drm_device *drm,
     size_t size, uint32_t *handle, struct drm_gem_cma_object **res_bo);
+static int drm_gem_cma_create_memattr(struct drm_device *drm, size_t size,
+    vm_memattr_t memattr, struct drm_gem_cma_object **res_bo);
 
 static void
 drm_gem_cma_destruct(struct drm_gem_cma_object *bo)
@@ -71,6 +88,7 @@ drm_gem_cma_destruct(struct drm_gem_cma_object *bo)
 		vm_page_lock(m);
 		m->oflags |= VPO_UNMANAGED;
 		m->flags &= ~PG_FICTITIOUS;
+		m->psind = 0;
 		vm_page_unwire_noq(m);
 		vm_page_free(m);
 		vm_page_unlock(m);
@@ -115,11 +133,36 @@ retry:
 	return (0);
 }
 
+/*
+ * Mark the first page of each superpage sized and aligned run of the
+ * buffer, the fault path then maps these runs with superpages.
+ */
+static void
+drm_gem_cma_set_psind(struct drm_gem_cma_object *bo)
+{
+#if VM_NRESERVLEVEL > 0
+	size_t i, n;
+
+	if (pagesizes[1] == 0)
+		return;
+
+	n = atop(pagesizes[1]);
+	for (i = 0; i + n <= bo->npages; i++) {
+		if ((VM_PAGE_TO_PHYS(bo->m[i]) & (pagesizes[1] - 1)) != 0)
+			continue;
+		bo->m[i]->psind = 1;
+		i += n - 1;
+	}
+#endif
+}
+
 /* Allocate memory for frame buffer */
 static int
-drm_gem_cma_alloc(struct drm_device *drm, struct drm_gem_cma_object *bo)
+drm_gem_cma_alloc(struct drm_device *drm, struct drm_gem_cma_object *bo,
+    vm_memattr_t memattr)
 {
 	size_t size;
+	u_long align;
 	vm_page_t m;
 	int i;	int rv;
 
@@ -128,9 +171,21 @@ drm_gem_cma_alloc(struct drm_device *drm, struct drm_gem_cma_object *bo)
 	bo->size = round_page(size);
 	bo->m = malloc(sizeof(vm_page_t *) * bo->npages, DRM_MEM_DRIVER,
 	    M_WAITOK | M_ZERO);
-
-	rv = drm_gem_cma_alloc_contig(bo->npages, PAGE_SIZE,
-	    VM_MEMATTR_WRITE_COMBINING, &(bo->m));
+	bo->memattr = memattr;
+
+	align = MAX(PAGE_SIZE, drm->mode_config.base_align);
+	rv = ENOMEM;
+	/*
+	 * Buffers of a superpage or more are aligned to one if possible, so
+	 * that they can be mapped with superpages.
+	 */
+	if (pagesizes[1] != 0 && bo->size >= pagesizes[1] &&
+	    pagesizes[1] > align)
+		rv = drm_gem_cma_alloc_contig(bo->npages, pagesizes[1],
+		    bo->memattr, &(bo->m));
+	if (rv != 0)
+		rv = drm_gem_cma_alloc_contig(bo->npages, align,
+		    bo->memattr, &(bo->m));
 	if (rv != 0) {
 		DRM_WARN("Cannot allocate memory for gem object.\n");
 		return (rv);
@@ -153,10 +208,56 @@ drm_gem_cma_alloc(struct drm_device *drm, struct drm_gem_cma_object *bo)
 		m->flags |= PG_FICTITIOUS;
 	}
 
+	drm_gem_cma_set_psind(bo);
+
 	bo->pbase = VM_PAGE_TO_PHYS(bo->m[0]);
 	return (0);
 }
 
+/*
+ * Buffers of the default attribute can use the direct map, which maps
+ * them with superpages where their alignment allows.  Changing the
+ * attribute of a page demotes the direct map around it, so the others
+ * get a mapping of their own.
+ */
+static bool
+drm_gem_cma_use_dmap(struct drm_gem_cma_object *bo)
+{
+
+#ifdef PMAP_HAS_DMAP
+	return (PMAP_HAS_DMAP && bo->memattr == VM_MEMATTR_DEFAULT);
+#else
+	return (false);
+#endif
+}
+
+vm_offset_t
+drm_gem_cma_map_kernel(struct drm_gem_cma_object *bo)
+{
+	vm_offset_t va;
+
+#ifdef PMAP_HAS_DMAP
+	if (drm_gem_cma_use_dmap(bo))
+		return (PHYS_TO_DMAP(bo->pbase));
+#endif
+
+	if (vmem_alloc(kmem_arena, bo->size, M_WAITOK | M_BESTFIT, &va) != 0)
+		return (0);
+	pmap_qenter(va, bo->m, bo->npages);
+	return (va);
+}
+
+void
+drm_gem_cma_unmap_kernel(struct drm_gem_cma_object *bo, vm_offset_t va)
+{
+
+	if (drm_gem_cma_use_dmap(bo))
+		return;
+
+	pmap_qremove(va, bo->npages);
+	vmem_free(kmem_arena, va, bo->size);
+}
+
 static int
 drm_gem_cma_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 {
@@ -184,11 +285,32 @@ drm_gem_cma_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 	VM_OBJECT_WLOCK(obj);
 	for (i = 0; i < bo->npages; i++) {
 		page = bo->m[i];
-		if (vm_page_busied(page))
-			goto fail_unlock;
-		if (vm_page_insert(page, obj, i))
-			goto fail_unlock;
-		vm_page_tryxbusy(page);
+		if (page->object != NULL && page->object != obj)
+			goto fail_unbusy;
+		if (!vm_page_tryxbusy(page)) {
+			/*
+			 * Faults on obj only busy these pages under the object
+			 * lock and insert them before dropping it.  A busy page
+			 * outside obj is held by someone else and there is
+			 * nothing to sleep on, fail instead of spinning.
+			 */
+			if (page->object != obj)
+				goto fail_unbusy;
+
+			/*
+			 * A concurrent fault is installing the buffer, let go
+			 * of our pages and sleep until it is done with them.
+			 */
+			while (i-- > 0)
+				vm_page_xunbusy(bo->m[i]);
+			if (!vm_page_busy_sleep(page, "drmflt", 0))
+				VM_OBJECT_WUNLOCK(obj);
+			return (VM_FAULT_RETRY);
+		}
+		if (page->object == NULL && vm_page_insert(page, obj, i)) {
+			vm_page_xunbusy(page);
+			goto fail_unbusy;
+		}
 		page->valid = VM_PAGE_BITS_ALL;
 	}
 	VM_OBJECT_WUNLOCK(obj);
@@ -199,9 +321,11 @@ drm_gem_cma_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 
 	return (VM_FAULT_NOPAGE);
 
-fail_unlock:
+fail_unbusy:
+	while (i-- > 0)
+		vm_page_xunbusy(bo->m[i]);
 	VM_OBJECT_WUNLOCK(obj);
-	DRM_ERROR("%s: insert failed\n", __func__);
+	DRM_ERROR("%s: cannot install pages\n", __func__);
 	return (VM_FAULT_SIGBUS);
 }
 
@@ -218,7 +342,8 @@ drm_gem_cma_create_with_handle(struct drm_file *file, struct drm_device *drm,
 	int rv;
 	struct drm_gem_cma_object *bo;
 
-	rv = drm_gem_cma_create(drm, size, &bo);
+	rv = drm_gem_cma_create_memattr(drm, size, drm_gem_cma_cached ?
+	    VM_MEMATTR_DEFAULT : VM_MEMATTR_WRITE_COMBINING, &bo);
 	if (rv != 0)
 		return (rv);
 
@@ -251,6 +376,54 @@ drm_gem_cma_get_pages(struct drm_gem_object *gem_obj, int *npages)
 	return (bo->m);
 }
 
+/*
+ * Cache maintenance for a range of a buffer. Only cacheable buffers need
+ * any, write-combined ones are never cached.
+ */
+static void
+drm_gem_cma_sync(struct drm_gem_cma_object *bo, enum dma_data_direction dir,
+    unsigned long offset, unsigned long len, bool for_cpu)
+{
+
+	if (bo->m != NULL && bo->memattr == VM_MEMATTR_DEFAULT)
+		drm_cache_sync_pages(bo->m, offset, len, dir, for_cpu);
+}
+
+/*
+ * Write CPU stores to a range of a buffer back to memory, for scanout.
+ */
+void
+drm_gem_cma_flush(struct drm_gem_cma_object *bo, unsigned long offset,
+    unsigned long len)
+{
+
+	drm_gem_cma_sync(bo, DMA_TO_DEVICE, offset, len, false);
+}
+
+int
+drm_gem_cma_prime_begin_cpu_access(struct drm_gem_object *gem_obj,
+    enum dma_data_direction dir, unsigned long offset, unsigned long len)
+{
+	struct drm_gem_cma_object *bo;
+
+	bo = container_of(gem_obj, struct drm_gem_cma_object, gem_obj);
+	drm_gem_cma_sync(bo, dir, offset, len, true);
+
+	return (0);
+}
+
+int
+drm_gem_cma_prime_end_cpu_access(struct drm_gem_object *gem_obj,
+    enum dma_data_direction dir, unsigned long offset, unsigned long len)
+{
+	struct drm_gem_cma_object *bo;
+
+	bo = container_of(gem_obj, struct drm_gem_cma_object, gem_obj);
+	drm_gem_cma_sync(bo, dir, offset, len, false);
+
+	return (0);
+}
+
 void
 drm_gem_cma_free_object(struct drm_gem_object *gem_obj)
 {
@@ -276,7 +449,7 @@ drm_gem_cma_dumb_create(struct drm_file *file, struct drm_device *drm_dev,
 	struct drm_gem_cma_object *bo;
 	int rv;
 
-	args->pitch = args->width * args->bpp / 8;
+	args->pitch = drm_mode_dumb_pitch(drm_dev, args->width, args->bpp);
 	args->size = args->height * args->pitch;
 	rv = drm_gem_cma_create_with_handle(file, drm_dev, args->size,
 	    &args->handle, &bo);
@@ -299,12 +472,25 @@ drm_gem_cma_mmap(struct file *file, struct vm_area_struct *vma)
 	if (bo->pbase == 0)
 		return (0);
 
+	/* Map with the attribute the pages were allocated with. */
+	vma->vm_page_prot = vm_get_page_prot(vma->vm_flags) |
+	    cachemode2protval(bo->memattr);
+
 	vma->vm_pfn = OFF_TO_IDX(bo->pbase);
 	return (rv);
 }
 
 int
 drm_gem_cma_create(struct drm_device *drm, size_t size, struct drm_gem_cma_object **res_bo)
+{
+
+	return (drm_gem_cma_create_memattr(drm, size,
+	    VM_MEMATTR_WRITE_COMBINING, res_bo));
+}
+
+static int
+drm_gem_cma_create_memattr(struct drm_device *drm, size_t size,
+    vm_memattr_t memattr, struct drm_gem_cma_object **res_bo)
 {
 	struct drm_gem_cma_object *bo;
 	int rv;
@@ -329,7 +515,7 @@ drm_gem_cma_create(struct drm_device *drm, size_t size, struct drm_gem_cma_objec
 		return (rv);
 	}
 
-	rv = drm_gem_cma_alloc(drm, bo);
+	rv = drm_gem_cma_alloc(drm, bo, memattr);
 	if (rv != 0) {
 		DRM_ERROR("%s: drm_gem_cma_alloc failed\n", __func__);
 		drm_gem_cma_free_object(&bo->gem_obj);
@@ -32,13 +32,17 @@ __FBSDID("$FreeBSD$");
 #include <sys/bus.h>
 #include <sys/kernel.h>
 #include <sys/malloc.h>
-#include <sys/vmem.h>
 
 #include <vm/vm.h>
 
 #include <machine/bus.h>
 
+#include <linux/reservation.h>
+
+#include <drm/drm_atomic.h>
+#include <drm/drm_atomic_uapi.h>
 #include <drm/drm_crtc_helper.h>
+#include <drm/drm_damage_helper.h>
 #include <drm/drm_fb_helper.h>
 #include <drm/drm_gem.h>
 #include <drm/drm_gem_cma_helper.h>
@@ -90,8 +94,7 @@ drm_gem_fb_destroy(struct drm_framebuffer *drm_fb)
 	for (i = 0; i < fb->nplanes; i++) {
 		bo = fb->planes[i];
 		if (bo != NULL) {
-			pmap_qremove(fb->planes_vbase[i], bo->npages);
-			vmem_free(kmem_arena, fb->planes_vbase[i], bo->size);
+			drm_gem_cma_unmap_kernel(bo, fb->planes_vbase[i]);
 			drm_gem_object_put_unlocked(&bo->gem_obj);
 		}
 	}
@@ -113,11 +116,142 @@ drm_gem_fb_create_handle(struct drm_framebuffer *drm_fb, struct drm_file *file,
 	return (rv);
 }
 
+/*
+ * Write a rectangle of a framebuffer back from the CPU caches, so scanout
+ * of cached buffers sees what was drawn. Write-combined buffers need
+ * nothing.
+ */
+static void
+drm_gem_fb_flush_rect(struct drm_fb_cma *fb, const struct drm_rect *rect)
+{
+	const struct drm_framebuffer *drm_fb;
+	const struct drm_format_info *info;
+	struct drm_gem_cma_object *bo;
+	unsigned long offset, len, pitch;
+	int i, x1, x2, y, y1, y2;
+
+	drm_fb = &fb->drm_fb;
+	info = drm_fb->format;
+	for (i = 0; i < fb->nplanes; i++) {
+		bo = fb->planes[i];
+		if (bo->memattr != VM_MEMATTR_DEFAULT)
+			continue;
+
+		x1 = rect->x1;
+		x2 = rect->x2;
+		y1 = rect->y1;
+		y2 = rect->y2;
+		if (i != 0) {
+			x1 /= info->hsub;
+			x2 = DIV_ROUND_UP(x2, info->hsub);
+			y1 /= info->vsub;
+			y2 = DIV_ROUND_UP(y2, info->vsub);
+		}
+
+		pitch = drm_fb->pitches[i];
+		offset = drm_fb->offsets[i] + y1 * pitch + x1 * info->cpp[i];
+		len = (x2 - x1) * info->cpp[i];
+		/* Full lines are a single range. */
+		if (len == pitch) {
+			drm_gem_cma_flush(bo, offset, len * (y2 - y1));
+			continue;
+		}
+		for (y = y1; y < y2; y++, offset += pitch)
+			drm_gem_cma_flush(bo, offset, len);
+	}
+}
+
+static int
+drm_gem_fb_dirty(struct drm_framebuffer *drm_fb, struct drm_file *file,
+    unsigned flags, unsigned color, struct drm_clip_rect *clips,
+    unsigned num_clips)
+{
+	struct drm_fb_cma *fb;
+	struct drm_rect rect;
+	unsigned i;
+
+	fb = container_of(drm_fb, struct drm_fb_cma, drm_fb);
+	if (num_clips == 0) {
+		drm_rect_init(&rect, 0, 0, drm_fb->width, drm_fb->height);
+		drm_gem_fb_flush_rect(fb, &rect);
+		return (0);
+	}
+
+	/* Flushing copy sources too is harmless, don't tell them apart. */
+	for (i = 0; i < num_clips; i++) {
+		rect.x1 = clips[i].x1;
+		rect.y1 = clips[i].y1;
+		rect.x2 = MIN(clips[i].x2, drm_fb->width);
+		rect.y2 = MIN(clips[i].y2, drm_fb->height);
+		if (rect.x1 < rect.x2 && rect.y1 < rect.y2)
+			drm_gem_fb_flush_rect(fb, &rect);
+	}
+
+	return (0);
+}
+
 static const struct drm_framebuffer_funcs gem_fb_funcs = {
 	.destroy = drm_gem_fb_destroy,
 	.create_handle = drm_gem_fb_create_handle,
+	.dirty = drm_gem_fb_dirty,
 };
 
+/*
+ * Plane helper prepare_fb hook for implicit fencing: unless userspace
+ * passed an explicit in-fence, make the commit wait for the last writer
+ * of the framebuffer.
+ */
+int
+drm_gem_fb_prepare_fb(struct drm_plane *plane, struct drm_plane_state *state)
+{
+	struct reservation_snapshot snap;
+	struct drm_fb_cma *fb;
+	int rv;
+
+	if (state->fb == NULL || state->fb->funcs != &gem_fb_funcs)
+		return (0);
+
+	fb = container_of(state->fb, struct drm_fb_cma, drm_fb);
+	rv = reservation_object_snapshot(fb->planes[0]->gem_obj.resv, false,
+	    &snap);
+	if (rv != 0)
+		return (rv);
+	if (snap.rs_excl != NULL)
+		drm_atomic_set_fence_for_plane(state,
+		    dma_fence_get(snap.rs_excl));
+	reservation_snapshot_fini(&snap);
+
+	return (0);
+}
+
+/*
+ * Plane helper prepare_fb hook: set up implicit fencing as above, and
+ * write the damage of a cached framebuffer back to memory before it is
+ * scanned out.
+ */
+int
+drm_gem_fb_flush_prepare_fb(struct drm_plane *plane,
+    struct drm_plane_state *state)
+{
+	struct drm_atomic_helper_damage_iter iter;
+	struct drm_fb_cma *fb;
+	struct drm_rect rect;
+	int rv;
+
+	rv = drm_gem_fb_prepare_fb(plane, state);
+	if (rv != 0)
+		return (rv);
+	if (state->fb == NULL || state->fb->funcs != &gem_fb_funcs)
+		return (0);
+
+	fb = container_of(state->fb, struct drm_fb_cma, drm_fb);
+	drm_atomic_helper_damage_iter_init(&iter, plane->state, state);
+	while (drm_atomic_helper_damage_iter_next(&iter, &rect))
+		drm_gem_fb_flush_rect(fb, &rect);
+
+	return (0);
+}
+
 static int
 drm_gem_fb_alloc(struct drm_device *drm,
     const struct drm_mode_fb_cmd2 *mode_cmd,
@@ -139,12 +273,9 @@ drm_gem_fb_alloc(struct drm_device *drm,
 	drm_helper_mode_fill_fb_struct(drm, &fb->drm_fb, mode_cmd);
 	for (i = 0; i < fb->nplanes; i++) {
 		fb->planes[i] = planes[i];
-		rv = vmem_alloc(kmem_arena, planes[i]->size,
-		    M_WAITOK | M_BESTFIT, &fb->planes_vbase[i]);
-		if (rv != 0)
+		fb->planes_vbase[i] = drm_gem_cma_map_kernel(planes[i]);
+		if (fb->planes_vbase[i] == 0)
 			return (ENOMEM);
-		pmap_qenter(fb->planes_vbase[i], planes[i]->m,
-		    planes[i]->npages);
 	}
 	rv = drm_framebuffer_init(drm, &fb->drm_fb, &gem_fb_funcs);
 	if (rv < 0) {
@@ -186,9 +317,13 @@ drm_fb_cma_probe(struct drm_fb_helper *helper,
 	memset(&mode_cmd, 0, sizeof(mode_cmd));
 	mode_cmd.width = sizes->surface_width;
 	mode_cmd.height = sizes->surface_height;
-	mode_cmd.pitches[0] = sizes->surface_width * bpp;
 	mode_cmd.pixel_format = drm_mode_legacy_fb_format(sizes->surface_bpp,
 	    sizes->surface_depth);
+	mode_cmd.pitches[0] = drm_mode_buffer_pitch(drm_dev,
+	    mode_cmd.pixel_format, DRM_PLANE_TYPE_PRIMARY,
+	    sizes->surface_width);
+	if (mode_cmd.pitches[0] == 0)
+		mode_cmd.pitches[0] = sizes->surface_width * bpp;
 	size = mode_cmd.pitches[0] * mode_cmd.height;
 
 	rv = drm_gem_cma_create(drm_dev, size, &bo);
@@ -27,6 +27,7 @@
 __FBSDID("$FreeBSD$");
 
 #include <sys/param.h>
+#include <sys/filedesc.h>
 #include <sys/priv.h>
 #include <sys/sglist.h>
 #include <sys/rwlock.h>
@@ -173,12 +174,13 @@ drm_fstub_kqfilter(struct file *file, struct knote *kn)
 		return (ENXIO);
 
 	fops = minor->dev->driver->fops;
-	if (fops->kqfilter != NULL) {
+	if (fops != NULL && fops->kqfilter != NULL)
 		rv = fops->kqfilter(file, kn);
-		return (rv);
-	}
+	else
+		rv = EINVAL;
 
-	return (EINVAL);
+	dev_relthread(cdev, ref);
+	return (rv);
 }
 
 static int
@@ -374,29 +376,10 @@ drm_cdev_pager_populate(vm_object_t vm_obj, vm_pindex_t pidx, int fault_type,
 	VM_OBJECT_WUNLOCK(vm_obj);
 
 //	down_write(&vmap->vm_mm->mmap_sem);
-	if (unlikely(vmap->vm_ops == NULL)) {
+	if (unlikely(vmap->vm_ops == NULL))
 		err = VM_FAULT_SIGBUS;
-	} else {
-		struct vm_fault vmf;
-
-		/* fill out VM fault structure */
-		vmf.virtual_address = (void *)(uintptr_t)IDX_TO_OFF(pidx);
-		vmf.flags = (fault_type & VM_PROT_WRITE) ? FAULT_FLAG_WRITE : 0;
-		vmf.pgoff = 0;
-		vmf.page = NULL;
-		vmf.vma = vmap;
-
-		vmap->vm_pfn_count = 0;
-		vmap->vm_pfn_pcount = &vmap->vm_pfn_count;
-		vmap->vm_obj = vm_obj;
-
-		err = vmap->vm_ops->fault(vmap, &vmf);
-
-		while (vmap->vm_pfn_count == 0 && err == VM_FAULT_NOPAGE) {
-			kern_yield(PRI_USER);
-			err = vmap->vm_ops->fault(vmap, &vmf);
-		}
-	}
+	else
+		err = drmkpi_vma_fault(vmap, vm_obj, pidx, fault_type);
 
 	/* translate return code */
 	switch (err) {
@@ -474,6 +457,134 @@ static struct cdev_pager_ops drm_dev_pg_ops = {
 	.cdev_pg_dtor		= drm_cdev_pager_dtor
 };
 
+/*
+ * Return a referenced device pager object for a mapping set up by a GEM
+ * mmap handler.  The object is keyed by vm_private_data, the GEM object,
+ * so every mapping of a buffer shares one VM object, whether it was made
+ * through the DRM node or through a dma-buf.  This matters for drivers
+ * whose fault handlers insert the buffer's real pages, which can only
+ * live in one object.  Consumes vmap, including the reference the mmap
+ * handler took for it.
+ */
+static int
+drm_vmap_get_object(struct vm_area_struct *vmap, vm_size_t size,
+    vm_prot_t prot, vm_ooffset_t foff, struct ucred *cred,
+    struct vm_object **obj)
+{
+	struct vm_area_struct *ptr;
+	void *vm_private_data;
+	bool vm_no_fault;
+	int rv;
+
+	if (vmap->vm_ops->open == NULL ||
+	    vmap->vm_ops->close == NULL ||
+	    vmap->vm_private_data == NULL) {
+		/* free allocated VM area struct */
+		drm_vmap_free(vmap);
+		return (EINVAL);
+	}
+
+	vm_private_data = vmap->vm_private_data;
+
+	rw_wlock(&drm_vma_lock);
+	TAILQ_FOREACH(ptr, &drm_vma_head, vm_entry) {
+		if (ptr->vm_private_data == vm_private_data)
+			break;
+	}
+	/* check if there is an existing VM area struct */
+	if (ptr != NULL) {
+		/* check if the VM area structure is invalid */
+		if (ptr->vm_ops == NULL ||
+		    ptr->vm_ops->open == NULL ||
+		    ptr->vm_ops->close == NULL) {
+			rv = ESTALE;
+			vm_no_fault = 1;
+		} else {
+			rv = EEXIST;
+			vm_no_fault = (ptr->vm_ops->fault == NULL);
+		}
+	} else {
+		/* insert VM area structure into list */
+		TAILQ_INSERT_TAIL(&drm_vma_head, vmap, vm_entry);
+		rv = 0;
+		vm_no_fault = (vmap->vm_ops->fault == NULL);
+	}
+	rw_wunlock(&drm_vma_lock);
+
+	if (rv != 0) {
+		/*
+		 * The existing VM area struct keeps its own reference,
+		 * drop the one taken for this one.
+		 */
+		vmap->vm_ops->close(vmap);
+		/* free allocated VM area struct */
+		drm_vmap_free(vmap);
+		/* check for stale VM area struct */
+		if (rv != EEXIST)
+			return (rv);
+	}
+
+	/* check if there is no fault handler */
+	if (vm_no_fault) {
+		*obj = cdev_pager_allocate(vm_private_data,
+		    OBJT_DEVICE, &drm_dev_pg_ops, size, prot,
+		    foff, cred);
+	} else {
+		*obj = cdev_pager_allocate(vm_private_data,
+		    OBJT_MGTDEVICE, &drm_mgtdev_pg_ops, size, prot,
+		    foff, cred);
+	}
+
+	/* check if allocating the VM object failed */
+	if (*obj == NULL) {
+		if (rv == 0) {
+			/* remove VM area struct from list */
+			drm_vmap_remove(vmap);
+			vmap->vm_ops->close(vmap);
+			/* free allocated VM area struct */
+			drm_vmap_free(vmap);
+		}
+		return (EINVAL);
+	}
+	return (0);
+}
+
+/*
+ * Back a dma-buf mapping of a GEM object with the VM object of the DRM
+ * node mappings of that object.  On return the mapping state of vma has
+ * moved to the pager and vma->vm_ops is cleared; on success
+ * vma->vm_backing_obj holds a reference for the caller.
+ */
+int
+drm_fbsd_vma_backing_object(struct vm_area_struct *vma)
+{
+	struct vm_area_struct *vmap;
+	vm_memattr_t attr;
+	vm_object_t obj;
+	int rv;
+
+	if (vma->vm_backing_obj != NULL || vma->vm_ops == NULL)
+		return (0);
+
+	vmap = kzalloc(sizeof(*vmap), GFP_KERNEL);
+	*vmap = *vma;
+	vma->vm_ops = NULL;
+
+	attr = pgprot2cachemode(vmap->vm_page_prot);
+	rv = drm_vmap_get_object(vmap, round_page(vma->vm_end -
+	    vma->vm_start), VM_PROT_ALL, 0, curthread->td_ucred, &obj);
+	if (rv != 0)
+		return (-rv);
+
+	if (attr != VM_MEMATTR_DEFAULT) {
+		VM_OBJECT_WLOCK(obj);
+		vm_object_set_memattr(obj, attr);
+		VM_OBJECT_WUNLOCK(obj);
+	}
+	vma->vm_backing_obj = obj;
+	return (0);
+}
+
 static int
 drm_fstub_do_mmap(struct file *file, const struct file_operations *fops,
     vm_ooffset_t *foff, vm_size_t size, struct vm_object **obj, vm_prot_t prot,
@@ -506,75 +617,29 @@ drm_fstub_do_mmap(struct file *file, const struct file_operations *fops,
 	}
 	attr = pgprot2cachemode(vmap->vm_page_prot);
 
-	if (vmap->vm_ops != NULL) {
-		struct vm_area_struct *ptr;
-		void *vm_private_data;
-		bool vm_no_fault;
-
-		if (vmap->vm_ops->open == NULL ||
-		    vmap->vm_ops->close == NULL ||
-		    vmap->vm_private_data == NULL) {
-			/* free allocated VM area struct */
-			drm_vmap_free(vmap);
-			return (EINVAL);
-		}
-
-		vm_private_data = vmap->vm_private_data;
-
-		rw_wlock(&drm_vma_lock);
-		TAILQ_FOREACH(ptr, &drm_vma_head, vm_entry) {
-			if (ptr->vm_private_data == vm_private_data)
-				break;
-		}
-		/* check if there is an existing VM area struct */
-		if (ptr != NULL) {
-			/* check if the VM area structure is invalid */
-			if (ptr->vm_ops == NULL ||
-			    ptr->vm_ops->open == NULL ||
-			    ptr->vm_ops->close == NULL) {
-				rv = ESTALE;
-				vm_no_fault = 1;
-			} else {
-				rv = EEXIST;
-				vm_no_fault = (ptr->vm_ops->fault == NULL);
-			}
-		} else {
-			/* insert VM area structure into list */
-			TAILQ_INSERT_TAIL(&drm_vma_head, vmap, vm_entry);
-			rv = 0;
-			vm_no_fault = (vmap->vm_ops->fault == NULL);
-		}
-		rw_wunlock(&drm_vma_lock);
-
-		if (rv != 0) {
-			/* free allocated VM area struct */
-			drm_vmap_free(vmap);
-			/* check for stale VM area struct */
-			if (rv != EEXIST)
-				return (rv);
-		}
-
-		/* check if there is no fault handler */
-		if (vm_no_fault) {
-			*obj = cdev_pager_allocate(vm_private_data,
-			    OBJT_DEVICE, &drm_dev_pg_ops, size, prot,
-			    *foff, td->td_ucred);
-		} else {
-			*obj = cdev_pager_allocate(vm_private_data,
-			    OBJT_MGTDEVICE, &drm_mgtdev_pg_ops, size, prot,
-			    *foff, td->td_ucred);
-		}
+	if (vmap->vm_backing_obj != NULL) {
+		/*
+		 * The driver backs this mapping with a VM object of its own
+		 * (e.g. pageable GEM objects) and handed us a reference on
+		 * it. Map that object directly so its pages are faulted in
+		 * and paged out by the VM system. The pages carry their own
+		 * memory attributes, so the object's are left alone. The
+		 * mapping holds a reference on the object, not on the GEM
+		 * object, so drop the one taken by mmap.
+		 */
+		*obj = vmap->vm_backing_obj;
+		if (vmap->vm_ops != NULL && vmap->vm_ops->close != NULL)
+			vmap->vm_ops->close(vmap);
+		drm_vmap_free(vmap);
+		*foff = 0;
+		return (0);
+	}
 
-		/* check if allocating the VM object failed */
-		if (*obj == NULL) {
-			if (rv == 0) {
-				/* remove VM area struct from list */
-				drm_vmap_remove(vmap);
-				/* free allocated VM area struct */
-				drm_vmap_free(vmap);
-			}
-			return (EINVAL);
-		}
+	if (vmap->vm_ops != NULL) {
+		rv = drm_vmap_get_object(vmap, size, prot, *foff,
+		    td->td_ucred, obj);
+		if (rv != 0)
+			return (rv);
 	} else {
 		struct sglist *sg;
 
@@ -739,6 +804,61 @@ out_unlock:
 	return -rv;
 }
 
+/*
+ * Open a new file on the device behind file, as another open(2) of it
+ * would.  Used to hand a lessee its own file.  The returned file is not
+ * in any descriptor table and holds one reference.
+ */
+struct file *
+drm_fbsd_file_clone(struct file *file)
+{
+	struct cdev *cdev;
+	struct drm_minor *minor;
+	const struct file_operations *fops;
+	struct file *nfile;
+	int ref, rv;
+
+	rv = drm_fstub_file_check(file, &cdev, &ref, &minor);
+	if (rv != 0)
+		return (ERR_PTR(-rv));
+
+	fops = minor->dev->driver->fops;
+	if (fops == NULL || fops->open == NULL) {
+		rv = ENODEV;
+		goto out_release;
+	}
+
+	rv = falloc_noinstall(curthread, &nfile);
+	if (rv != 0)
+		goto out_release;
+
+	/*
+	 * Keep badfileops until the open succeeded, so that dropping a
+	 * half-opened file does not call into the driver.
+	 */
+	nfile->f_flag = file->f_flag;
+	nfile->f_vnode = file->f_vnode;
+	vhold(nfile->f_vnode);
+
+	mutex_lock(&drm_global_mutex);
+	rv = -fops->open((struct inode*)nfile->f_vnode, nfile);
+	mutex_unlock(&drm_global_mutex);
+	if (rv != 0) {
+		vdrop(nfile->f_vnode);
+		nfile->f_vnode = NULL;
+		fdrop(nfile, curthread);
+		goto out_release;
+	}
+
+	finit(nfile, file->f_flag, DTYPE_DEV, nfile->f_data, &drmfileops);
+	dev_relthread(cdev, ref);
+	return (nfile);
+
+out_release:
+	dev_relthread(cdev, ref);
+	return (ERR_PTR(-rv));
+}
+
 static struct cdevsw drm_cdevsw = {
 	.d_version =	D_VERSION,
 	.d_fdopen = 	drm_cdev_fdopen,
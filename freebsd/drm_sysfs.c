@@ -51,3 +51,8 @@ void
 drm_sysfs_hotplug_event(struct drm_device *dev __unused)
 {
 }
+
+void
+drm_sysfs_lease_event(struct drm_device *dev __unused)
+{
+}
@@ -44,6 +44,7 @@ __FBSDID("$FreeBSD$");
 #include <machine/bus.h>
 
 #include <dev/extres/clk/clk.h>
+#include <drm/drm_cache.h>
 #include <drm/drm_crtc_helper.h>
 #include <drm/drm_drv.h>
 #include <drm/drm_fb_helper.h>
@@ -62,6 +63,21 @@ tegra_bo_destruct(struct tegra_bo *bo)
 		vmem_free(kmem_arena, bo->vbase, round_page(bo->gem_obj.size));
 	}
 
+	if (bo->pobj != NULL) {
+		/*
+		 * Pinned pages belong to the object now, unwire them and let
+		 * the object free them once the last mapping is gone.
+		 */
+		if (bo->m != NULL) {
+			VM_OBJECT_WLOCK(bo->pobj);
+			for (i = 0; i < bo->npages; i++)
+				vm_page_unwire(bo->m[i], PQ_ACTIVE);
+			VM_OBJECT_WUNLOCK(bo->pobj);
+		}
+		vm_object_deallocate(bo->pobj);
+		return;
+	}
+
 	for (i = 0; i < bo->npages; i++) {
 		m = bo->m[i];
 		vm_page_lock(m);
@@ -141,8 +157,10 @@ tegra_bo_alloc(struct drm_device *drm, struct tegra_bo *bo)
 	bo->m = malloc(sizeof(vm_page_t *) * bo->npages, DRM_MEM_DRIVER,
 	    M_WAITOK | M_ZERO);
 
-	rv = tegra_bo_alloc_contig(bo->npages, PAGE_SIZE,
-	    VM_MEMATTR_WRITE_COMBINING, &(bo->m));
+	bo->memattr = VM_MEMATTR_WRITE_COMBINING;
+
+	rv = tegra_bo_alloc_contig(bo->npages, PAGE_SIZE, bo->memattr,
+	    &(bo->m));
 	if (rv != 0) {
 		DRM_WARN("Cannot allocate memory for gem object.\n");
 		return (rv);
@@ -169,8 +187,193 @@ tegra_bo_alloc(struct drm_device *drm, struct tegra_bo *bo)
 	return (0);
 }
 
+/*
+ * Pageable buffers are backed by an anonymous, swap backed VM object.
+ * Pages are allocated on first access and may be paged out, so buffers
+ * which are never scanned out do not consume contiguous memory.
+ */
+static int
+tegra_bo_alloc_pageable(struct drm_device *drm, struct tegra_bo *bo)
+{
+	size_t size;
+
+	size = round_page(bo->gem_obj.size);
+	bo->npages = atop(size);
+	bo->size = size;
+	bo->pobj = vm_pager_allocate(OBJT_DEFAULT, NULL, size,
+	    VM_PROT_DEFAULT, 0, curthread->td_ucred);
+	if (bo->pobj == NULL) {
+		DRM_WARN("Cannot allocate VM object for gem object.\n");
+		return (ENOMEM);
+	}
+
+	return (0);
+}
+
+/*
+ * Exclusive busy every page of a pageable buffer that holds data, paging
+ * in those that were paged out, and return with the object locked and the
+ * pages in ma.  Pages that were never touched have no backing and are left
+ * NULL, they read as zero.  On error nothing is busied.
+ */
+static int
+tegra_bo_pin_grab(vm_object_t obj, int npages, vm_page_t *ma)
+{
+	vm_page_t m;
+	int i, j, rv;
+
+	VM_OBJECT_ASSERT_WLOCKED(obj);
+
+	/* Page in what was paged out, so the pass below rarely has to. */
+	for (i = 0; i < npages; i++) {
+		if (vm_page_lookup(obj, i) != NULL ||
+		    !vm_pager_has_page(obj, i, NULL, NULL))
+			continue;
+		rv = vm_page_grab_valid(&m, obj, i, 0);
+		if (rv != VM_PAGER_OK)
+			return (EIO);
+		vm_page_xunbusy(m);
+	}
+
+	/*
+	 * Busy all pages without dropping the object lock, so that none
+	 * can be paged out or newly mapped behind our back.  Whenever we
+	 * have to sleep, release what we hold and start over.
+	 */
+retry:
+	for (i = 0; i < npages; i++) {
+		m = vm_page_lookup(obj, i);
+		if (m == NULL && !vm_pager_has_page(obj, i, NULL, NULL)) {
+			ma[i] = NULL;
+			continue;
+		}
+		if (m != NULL && vm_page_tryxbusy(m) != 0) {
+			if (vm_page_all_valid(m) && !vm_page_wired(m)) {
+				ma[i] = m;
+				continue;
+			}
+			vm_page_xunbusy(m);
+		}
+
+		for (j = 0; j < i; j++) {
+			if (ma[j] != NULL)
+				vm_page_xunbusy(ma[j]);
+		}
+		/* Someone else holds the page for I/O, e.g. physio. */
+		if (m != NULL && vm_page_wired(m))
+			return (EBUSY);
+		if (m != NULL && vm_page_busied(m)) {
+			if (vm_page_busy_sleep(m, "tgpin", 0))
+				VM_OBJECT_WLOCK(obj);
+			goto retry;
+		}
+		rv = vm_page_grab_valid(&m, obj, i, 0);
+		if (rv != VM_PAGER_OK)
+			return (EIO);
+		vm_page_xunbusy(m);
+		goto retry;
+	}
+
+	return (0);
+}
+
+/*
+ * Make a pageable buffer usable for scanout: move its contents into a
+ * wired, physically contiguous run of pages and put those pages in place
+ * of the pageable ones, so existing and future CPU mappings stay coherent
+ * with what the display controller reads. Once pinned, a buffer stays
+ * contiguous until it is freed.
+ */
 int
-tegra_bo_create(struct drm_device *drm, size_t size, struct tegra_bo **res_bo)
+tegra_bo_pin(struct tegra_bo *bo)
+{
+	vm_object_t obj;
+	vm_page_t *m, *src;
+	int i, rv;
+
+	obj = bo->pobj;
+	if (obj == NULL || bo->m != NULL)
+		return (0);
+
+	m = malloc(sizeof(vm_page_t *) * bo->npages, DRM_MEM_DRIVER,
+	    M_WAITOK | M_ZERO);
+	src = malloc(sizeof(vm_page_t *) * bo->npages, DRM_MEM_DRIVER,
+	    M_WAITOK | M_ZERO);
+	rv = tegra_bo_alloc_contig(bo->npages, PAGE_SIZE,
+	    VM_MEMATTR_WRITE_COMBINING, &m);
+	if (rv != 0) {
+		DRM_WARN("Cannot allocate scanout memory for gem object.\n");
+		free(src, DRM_MEM_DRIVER);
+		free(m, DRM_MEM_DRIVER);
+		return (rv);
+	}
+
+	VM_OBJECT_WLOCK(obj);
+	rv = bo->m != NULL ? 0 : tegra_bo_pin_grab(obj, bo->npages, src);
+	if (bo->m != NULL) {
+		/* Lost the race against another pin. */
+		if (rv == 0) {
+			for (i = 0; i < bo->npages; i++) {
+				if (src[i] != NULL)
+					vm_page_xunbusy(src[i]);
+			}
+		}
+		VM_OBJECT_WUNLOCK(obj);
+		rv = 0;
+		goto fail;
+	}
+	if (rv != 0) {
+		VM_OBJECT_WUNLOCK(obj);
+		goto fail;
+	}
+
+	/*
+	 * The pages are busied and the object is locked, nothing can map
+	 * them anew.  Revoke the existing mappings before copying, so that
+	 * no CPU write can land after its page has been copied.
+	 */
+	for (i = 0; i < bo->npages; i++) {
+		if (src[i] == NULL)
+			continue;
+		pmap_remove_all(src[i]);
+		pmap_copy_page(src[i], m[i]);
+		vm_page_free(src[i]);
+	}
+
+	/* Release the swap space of the pageable copies. */
+	vm_object_page_remove(obj, 0, bo->npages, 0);
+
+	for (i = 0; i < bo->npages; i++) {
+		/* Same hack as in tegra_bo_alloc(), the object needs managed
+		 * pages. */
+		m[i]->oflags &= ~VPO_UNMANAGED;
+		vm_page_insert(m[i], obj, i);
+		m[i]->valid = VM_PAGE_BITS_ALL;
+		m[i]->dirty = VM_PAGE_BITS_ALL;
+	}
+	bo->pbase = VM_PAGE_TO_PHYS(m[0]);
+	bo->memattr = VM_MEMATTR_WRITE_COMBINING;
+	bo->m = m;
+	VM_OBJECT_WUNLOCK(obj);
+	free(src, DRM_MEM_DRIVER);
+
+	return (0);
+
+fail:
+	for (i = 0; i < bo->npages; i++) {
+		vm_page_lock(m[i]);
+		vm_page_unwire(m[i], PQ_NONE);
+		vm_page_free(m[i]);
+		vm_page_unlock(m[i]);
+	}
+	free(src, DRM_MEM_DRIVER);
+	free(m, DRM_MEM_DRIVER);
+	return (rv);
+}
+
+int
+tegra_bo_create(struct drm_device *drm, size_t size, bool contig,
+    struct tegra_bo **res_bo)
 {
 	struct tegra_bo *bo;
 	int rv;
@@ -193,7 +396,10 @@ tegra_bo_create(struct drm_device *drm, size_t size, struct tegra_bo **res_bo)
 		return (rv);
 	}
 
-	rv = tegra_bo_alloc(drm, bo);
+	if (contig)
+		rv = tegra_bo_alloc(drm, bo);
+	else
+		rv = tegra_bo_alloc_pageable(drm, bo);
 	if (rv != 0) {
 		tegra_bo_free_object(&bo->gem_obj);
 		return (rv);
@@ -207,12 +413,12 @@ tegra_bo_create(struct drm_device *drm, size_t size, struct tegra_bo **res_bo)
 
 static int
 tegra_bo_create_with_handle(struct drm_file *file, struct drm_device *drm,
-    size_t size, uint32_t *handle, struct tegra_bo **res_bo)
+    size_t size, bool contig, uint32_t *handle, struct tegra_bo **res_bo)
 {
 	int rv;
 	struct tegra_bo *bo;
 
-	rv = tegra_bo_create(drm, size, &bo);
+	rv = tegra_bo_create(drm, size, contig, &bo);
 	if (rv != 0)
 		return (rv);
 
@@ -233,16 +439,17 @@ static int
 tegra_bo_dumb_create(struct drm_file *file, struct drm_device *drm_dev,
     struct drm_mode_create_dumb *args)
 {
-	struct tegra_drm *drm;
 	struct tegra_bo *bo;
 	int rv;
 
-	drm = container_of(drm_dev, struct tegra_drm, drm_dev);
-
-	args->pitch= (args->width * args->bpp + 7) / 8;
-	args->pitch = roundup(args->pitch, drm->pitch_align);
+	args->pitch = drm_mode_dumb_pitch(drm_dev, args->width, args->bpp);
 	args->size = args->pitch * args->height;
-	rv = tegra_bo_create_with_handle(file, drm_dev, args->size,
+	/*
+	 * Dumb buffers are often only used as staging or offscreen buffers,
+	 * so back them with pageable memory and make them contiguous only
+	 * when they are turned into a framebuffer.
+	 */
+	rv = tegra_bo_create_with_handle(file, drm_dev, args->size, false,
 	    &args->handle, &bo);
 
 	return (rv);
@@ -275,11 +482,32 @@ tegra_bo_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 	VM_OBJECT_WLOCK(obj);
 	for (i = 0; i < bo->npages; i++) {
 		page = bo->m[i];
-		if (vm_page_busied(page))
-			goto fail_unlock;
-		if (vm_page_insert(page, obj, i))
-			goto fail_unlock;
-		vm_page_xbusy(page);
+		if (page->object != NULL && page->object != obj)
+			goto fail_unbusy;
+		if (!vm_page_tryxbusy(page)) {
+			/*
+			 * Faults on obj only busy these pages under the object
+			 * lock and insert them before dropping it.  A busy page
+			 * outside obj is held by someone else and there is
+			 * nothing to sleep on, fail instead of spinning.
+			 */
+			if (page->object != obj)
+				goto fail_unbusy;
+
+			/*
+			 * A concurrent fault is installing the buffer, let go
+			 * of our pages and sleep until it is done with them.
+			 */
+			while (i-- > 0)
+				vm_page_xunbusy(bo->m[i]);
+			if (!vm_page_busy_sleep(page, "drmflt", 0))
+				VM_OBJECT_WUNLOCK(obj);
+			return (VM_FAULT_RETRY);
+		}
+		if (page->object == NULL && vm_page_insert(page, obj, i)) {
+			vm_page_xunbusy(page);
+			goto fail_unbusy;
+		}
 		page->valid = VM_PAGE_BITS_ALL;
 	}
 	VM_OBJECT_WUNLOCK(obj);
@@ -290,9 +518,11 @@ printf("%s: pidx: %llu, start: 0x%08X, addr: 0x%08lX\n", __func__, pidx, vma->vm
 
 	return (VM_FAULT_NOPAGE);
 
-fail_unlock:
+fail_unbusy:
+	while (i-- > 0)
+		vm_page_xunbusy(bo->m[i]);
 	VM_OBJECT_WUNLOCK(obj);
-	printf("%s: insert failed\n", __func__);
+	printf("%s: cannot install pages\n", __func__);
 	return (VM_FAULT_SIGBUS);
 }
 
@@ -309,6 +539,12 @@ tegra_bo_mmap(struct drm_gem_object *gem_obj, struct vm_area_struct *vma)
 	struct tegra_bo *bo;
 
 	bo = container_of(gem_obj, struct tegra_bo, gem_obj);
+	if (bo->pobj != NULL) {
+		/* Map the backing object itself, pinned or not. */
+		vm_object_reference(bo->pobj);
+		vma->vm_backing_obj = bo->pobj;
+		return (0);
+	}
 	if (bo->pbase == 0)
 		return (0);
 
@@ -316,6 +552,63 @@ tegra_bo_mmap(struct drm_gem_object *gem_obj, struct vm_area_struct *vma)
 	return (0);
 }
 
+/*
+ * Cache maintenance for a range of a buffer. Contiguous buffers need none
+ * while they are write-combined, pageable ones are cacheable and only their
+ * resident pages can hold lines of the range.
+ */
+static void
+tegra_bo_sync(struct tegra_bo *bo, enum dma_data_direction dir,
+    unsigned long offset, unsigned long len, bool for_cpu)
+{
+	vm_object_t obj;
+	vm_page_t m;
+	vm_pindex_t pidx;
+	unsigned long chunk, poff;
+
+	obj = bo->pobj;
+	if (obj != NULL) {
+		VM_OBJECT_RLOCK(obj);
+		if (bo->m == NULL) {
+			pidx = OFF_TO_IDX(offset);
+			poff = offset - IDX_TO_OFF(pidx);
+			for (; len > 0; len -= chunk, pidx++, poff = 0) {
+				chunk = MIN(len, PAGE_SIZE - poff);
+				m = vm_page_lookup(obj, pidx);
+				if (m != NULL && vm_page_all_valid(m))
+					drm_cache_sync_pages(&m, poff, chunk,
+					    dir, for_cpu);
+			}
+			VM_OBJECT_RUNLOCK(obj);
+			return;
+		}
+		VM_OBJECT_RUNLOCK(obj);
+	}
+
+	if (bo->m != NULL && bo->memattr == VM_MEMATTR_DEFAULT)
+		drm_cache_sync_pages(bo->m, offset, len, dir, for_cpu);
+}
+
+static int
+tegra_bo_begin_cpu_access(struct drm_gem_object *gem_obj,
+    enum dma_data_direction dir, unsigned long offset, unsigned long len)
+{
+
+	tegra_bo_sync(container_of(gem_obj, struct tegra_bo, gem_obj), dir,
+	    offset, len, true);
+	return (0);
+}
+
+static int
+tegra_bo_end_cpu_access(struct drm_gem_object *gem_obj,
+    enum dma_data_direction dir, unsigned long offset, unsigned long len)
+{
+
+	tegra_bo_sync(container_of(gem_obj, struct tegra_bo, gem_obj), dir,
+	    offset, len, false);
+	return (0);
+}
+
 /* Fill up relevant fields in drm_driver ops */
 void
 tegra_bo_driver_register(struct drm_driver *drm_drv)
@@ -325,4 +618,6 @@ tegra_bo_driver_register(struct drm_driver *drm_drv)
 	drm_drv->dumb_create = tegra_bo_dumb_create;
 	drm_drv->dumb_map_offset = drm_gem_dumb_map_offset;
 	drm_drv->dumb_destroy = drm_gem_dumb_destroy;
+	drm_drv->gem_prime_begin_cpu_access = tegra_bo_begin_cpu_access;
+	drm_drv->gem_prime_end_cpu_access = tegra_bo_end_cpu_access;
 }
@@ -189,6 +189,7 @@ struct dc_softc {
 	hwreset_t		hwreset_dc;
 
 	int			pitch_align;
+	u_int			vblank_syncpt;
 
 	struct tegra_crtc 	tegra_crtc;
 	struct drm_pending_vblank_event *event;
@@ -1086,7 +1087,7 @@ dc_crtc_prepare(struct drm_crtc *drm_crtc)
 	WR4(sc, DC_CMD_GENERAL_INCR_SYNCPT_CNTRL, SYNCPT_CNTRL_NO_STALL);
 	/* XXX allocate syncpoint from host1x */
 	WR4(sc, DC_CMD_CONT_SYNCPT_VSYNC, SYNCPT_VSYNC_ENABLE |
-	    (sc->tegra_crtc.nvidia_head == 0 ? SYNCPT_VBLANK0: SYNCPT_VBLANK1));
+	    sc->vblank_syncpt);
 
 	WR4(sc, DC_CMD_DISPLAY_POWER_CONTROL,
 	    PW0_ENABLE | PW1_ENABLE | PW2_ENABLE | PW3_ENABLE |
@@ -1321,11 +1322,15 @@ dc_atomic_destroy_state(struct drm_crtc *drm_crtc,
 static uint32_t
 dc_get_vblank_counter(struct drm_crtc *drm_crtc)
 {
+	struct dc_softc *sc;
 	struct tegra_crtc *crtc;
 
 	crtc = container_of(drm_crtc, struct tegra_crtc, drm_crtc);
-	/* XXXX read counter from syncpt engine */
-	return (drm_crtc_vblank_count(drm_crtc));
+	sc = device_get_softc(crtc->dev);
+
+	/* The DC bumps its vblank syncpoint on every frame. */
+	return (TEGRA_DRM_READ_SYNCPT(device_get_parent(sc->dev),
+	    sc->vblank_syncpt));
 }
 
 static int
@@ -1469,8 +1474,8 @@ dc_init_client(device_t dev, device_t host1x, struct tegra_drm *drm)
 	DRM_TRACE();
 	sc = device_get_softc(dev);
 
-	if (drm->pitch_align < sc->pitch_align)
-		drm->pitch_align = sc->pitch_align;
+	if (drm->drm_dev.mode_config.pitch_align < sc->pitch_align)
+		drm->drm_dev.mode_config.pitch_align = sc->pitch_align;
 
 	rv = dc_primary_plane_create(sc, drm, &primary);
 	if (rv!= 0){
@@ -1566,6 +1571,8 @@ get_fdt_resources(struct dc_softc *sc, phandle_t node)
 		    "Cannot get 'nvidia,head' property\n");
 		return (rv);
 	}
+	sc->vblank_syncpt = (sc->tegra_crtc.nvidia_head == 0) ?
+	    SYNCPT_VBLANK0 : SYNCPT_VBLANK1;
 	return (0);
 }
 
@@ -43,6 +43,9 @@ struct tegra_bo {
 	size_t			npages;
 	size_t			size;		/* Rounded to page */
 	vm_page_t 		*m;
+	vm_memattr_t		memattr;	/* Of the contiguous pages */
+	/* Pageable backing store, NULL for buffers allocated contiguous */
+	vm_object_t		pobj;
 };
 
 struct tegra_plane {
@@ -89,7 +92,6 @@ struct tegra_drm_encoder {
 struct tegra_drm {
 	struct drm_device 	drm_dev;
 	struct tegra_fb 	*fb;		/* Prime framebuffer */
-	int			pitch_align;
 };
 
 /* tegra_drm_subr.c */
@@ -120,8 +122,9 @@ void tegra_drm_fb_destroy(struct drm_device *drm);
 
 /* tegra_bo.c */
 struct tegra_bo;
-int tegra_bo_create(struct drm_device *drm, size_t size,
+int tegra_bo_create(struct drm_device *drm, size_t size, bool contig,
     struct tegra_bo **res_bo);
+int tegra_bo_pin(struct tegra_bo *bo);
 void tegra_bo_driver_register(struct drm_driver *drm_drv);
 int tegra_bo_mmap(struct drm_gem_object *gem_obj, struct vm_area_struct *vma);
 
@@ -49,6 +49,14 @@ METHOD int deregister_client{
 	device_t		client;
 };
 
+/**
+ * Read the current value of a syncpoint
+ */
+METHOD uint32_t read_syncpt{
+	device_t		host1x;
+	u_int			id;
+};
+
 /**
  * Call client init method
  */
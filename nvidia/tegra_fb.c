@@ -138,7 +138,6 @@ tegra_fb_probe(struct drm_fb_helper *helper,
     struct drm_fb_helper_surface_size *sizes)
 {
 	u_int bpp, size; //, offs;
-	struct tegra_drm *drm;
 	struct tegra_fb *fb;
 	struct fb_info *info;
 	struct tegra_bo *bo;
@@ -154,20 +153,22 @@ tegra_fb_probe(struct drm_fb_helper *helper,
 
 	drm_dev = helper->dev;
 	fb = container_of(helper, struct tegra_fb, fb_helper);
-	drm = container_of(drm_dev, struct tegra_drm, drm_dev);
 	bpp = (sizes->surface_bpp + 7) / 8;
 
 	/* Create mode_cmd */
 	memset(&mode_cmd, 0, sizeof(mode_cmd));
 	mode_cmd.width = sizes->surface_width;
 	mode_cmd.height = sizes->surface_height;
-	mode_cmd.pitches[0] = roundup(sizes->surface_width * bpp,
-	    drm->pitch_align);
 	mode_cmd.pixel_format = drm_mode_legacy_fb_format(sizes->surface_bpp,
 	    sizes->surface_depth);
+	mode_cmd.pitches[0] = drm_mode_buffer_pitch(drm_dev,
+	    mode_cmd.pixel_format, DRM_PLANE_TYPE_PRIMARY,
+	    sizes->surface_width);
+	if (mode_cmd.pitches[0] == 0)
+		mode_cmd.pitches[0] = sizes->surface_width * bpp;
 	size = mode_cmd.pitches[0] * mode_cmd.height;
 
-	rv = tegra_bo_create(drm_dev, size, &bo);
+	rv = tegra_bo_create(drm_dev, size, true, &bo);
 	if (rv != 0)
 		return (rv);
 
@@ -327,6 +328,13 @@ tegra_drm_fb_create(struct drm_device *drm, struct drm_file *file,
 		if (gem_obj->size < size)
 			goto fail;
 		planes[i] = container_of(gem_obj, struct tegra_bo, gem_obj);
+
+		/* The display controller needs physically contiguous memory. */
+		rv = tegra_bo_pin(planes[i]);
+		if (rv != 0) {
+			i++;
+			goto fail;
+		}
 	}
 
 	rv = fb_alloc(drm, cmd, planes, info->num_planes, &fb);
@@ -70,6 +70,9 @@ __FBSDID("$FreeBSD$");
 #define	WR4(_sc, _r, _v)	bus_rite_4((_sc)->mem_res, (_r), (_v))
 #define	RD4(_sc, _r)		bus_read_4((_sc)->mem_res, (_r))
 
+#define	HOST1X_SYNC_OFFSET	0x2100
+#define	HOST1X_SYNC_SYNCPT(x)	(HOST1X_SYNC_OFFSET + 0xf80 + (x) * 4)
+
 #define	LOCK(_sc)		sx_xlock(&(_sc)->lock)
 #define	UNLOCK(_sc)		sx_xunlock(&(_sc)->lock)
 #define	SLEEP(_sc, timeout)	sx_sleep(sc, &sc->lock, 0, "host1x", timeout);
@@ -499,6 +502,7 @@ static const struct file_operations host1x_drm_fops = {
 	.mmap = host1x_drm_mmap,
 	.poll = drm_poll,
 	.read = drm_read,
+	.kqfilter = drm_kqfilter,
 	.compat_ioctl = drm_compat_ioctl,
 //	.llseek = noop_llseek,
 };
@@ -552,7 +556,9 @@ host1x_drm_init(struct drm_device *drm_dev)
 		goto fail_host1x;
 
 	drm_dev->irq_enabled = true;
+	/* The vblank syncpoints count frames while interrupts are off */
 	drm_dev->max_vblank_count = 0xffffffff;
+	drm_dev->vblank_disable_immediate = true;
 
 	rv = drm_vblank_init(drm_dev, drm_dev->mode_config.num_crtc);
 	if (rv != 0)
@@ -626,6 +632,17 @@ host1x_fb_helper_getinfo(device_t dev)
 	return (tegra_drm_fb_getinfo(&sc->tegra_drm->drm_dev));
 }
 
+static uint32_t
+host1x_read_syncpt(device_t dev, u_int id)
+{
+	struct host1x_softc *sc;
+
+	sc = device_get_softc(dev);
+
+	/* Called with vblank spinlocks held, must not sleep */
+	return (RD4(sc, HOST1X_SYNC_SYNCPT(id)));
+}
+
 static int
 host1x_register_client(device_t dev, device_t client)
 {
@@ -885,6 +902,7 @@ static device_method_t host1x_methods[] = {
 	/* tegra drm interface */
 	DEVMETHOD(tegra_drm_register_client,	host1x_register_client),
 	DEVMETHOD(tegra_drm_deregister_client,	host1x_deregister_client),
+	DEVMETHOD(tegra_drm_read_syncpt,	host1x_read_syncpt),
 
 	DEVMETHOD_END
 };
@@ -117,6 +117,8 @@ static struct drm_driver rk_drm_driver = {
 	.gem_prime_get_sg_table	= rockchip_gem_prime_get_sg_table,
 	.gem_prime_import_sg_table	= rockchip_gem_prime_import_sg_table,
 	.gem_prime_mmap		= rockchip_gem_mmap_buf,
+	.gem_prime_begin_cpu_access	= drm_gem_cma_prime_begin_cpu_access,
+	.gem_prime_end_cpu_access	= drm_gem_cma_prime_end_cpu_access,
 
 	.name			= "rockchip",
 	.desc			= "Rockchip Display Subsystem",
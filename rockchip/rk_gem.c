@@ -197,16 +197,20 @@ rockchip_drm_gem_object_mmap(struct drm_gem_object *obj,
 
 	bo = container_of(obj, struct drm_gem_cma_object, gem_obj);
 	if (bo->pbase == 0)
-		return (0);
+		return (-EINVAL);
 
+	/* The reference taken here is dropped by the vm_ops close. */
 	error = drm_gem_mmap_obj(obj, npages * PAGE_SIZE, vma);
-	drm_gem_object_put_unlocked(obj);
-	if (error)
+	if (error) {
 		printf("%s: error %d\n", __func__, error);
+		return (error);
+	}
 
+	vma->vm_page_prot = vm_get_page_prot(vma->vm_flags) |
+	    cachemode2protval(bo->memattr);
 	vma->vm_pfn = OFF_TO_IDX(bo->pbase);
 
-	return (error);
+	return (0);
 }
 
 int
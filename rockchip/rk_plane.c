@@ -54,6 +54,7 @@ __FBSDID("$FreeBSD$");
 #include <drm/drm_drv.h>
 #include <drm/drm_atomic.h>
 #include <drm/drm_atomic_helper.h>
+#include <drm/drm_damage_helper.h>
 #include <drm/drm_gem_framebuffer_helper.h>
 #include <drm/drm_plane_helper.h>
 #include <drm/drm_fb_cma_helper.h>
@@ -82,7 +83,8 @@ __FBSDID("$FreeBSD$");
 
 #define	dprintf(fmt, ...)
 
-static const u32 rk_vop_plane_formats[] = {
+/* Win0 can fetch semi-planar YUV, the win2 cursor plane is RGB only. */
+static const u32 rk_vop_win0_formats[] = {
 	DRM_FORMAT_XRGB8888,
 	DRM_FORMAT_ARGB8888,
 	DRM_FORMAT_XBGR8888,
@@ -96,6 +98,33 @@ static const u32 rk_vop_plane_formats[] = {
 	DRM_FORMAT_NV24,
 };
 
+static const u32 rk_vop_win2_formats[] = {
+	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_ARGB8888,
+	DRM_FORMAT_XBGR8888,
+	DRM_FORMAT_ABGR8888,
+	DRM_FORMAT_RGB888,
+	DRM_FORMAT_BGR888,
+	DRM_FORMAT_RGB565,
+	DRM_FORMAT_BGR565,
+};
+
+/*
+ * BT.601 limited range YUV to RGB, in the layout of the win0 Y2R
+ * coefficient block: the nine 13-bit matrix terms packed two per register
+ * followed by the three offsets.
+ */
+static const uint32_t rk_vop_bt601_y2r[] = {
+	0x4a8 | (0x0 << 16),
+	0x662 | (0x4a8 << 16),
+	0x1e6f | (0x1cbf << 16),
+	0x4a8 | (0x812 << 16),
+	0x0,
+	0x321168,
+	0x0877cf,
+	0x2eb127,
+};
+
 static enum rockchip_data_format
 vop_convert_format(uint32_t format)
 {
@@ -127,8 +156,10 @@ static int
 rk_vop_plane_atomic_check(struct drm_plane *plane,
     struct drm_plane_state *state)
 {
+	const struct drm_format_info *fmt;
 	struct drm_crtc *crtc;
 	struct drm_crtc_state *crtc_state;
+	int error;
 
 	dprintf("%s\n", __func__);
 
@@ -140,10 +171,24 @@ rk_vop_plane_atomic_check(struct drm_plane *plane,
 	if (crtc_state == NULL)
 		return (-EINVAL);
 
-	return (drm_atomic_helper_check_plane_state(state, crtc_state,
+	error = drm_atomic_helper_check_plane_state(state, crtc_state,
 	    DRM_PLANE_HELPER_NO_SCALING,
 	    DRM_PLANE_HELPER_NO_SCALING,
-	    true, true));
+	    true, true);
+	if (error != 0)
+		return (error);
+
+	/*
+	 * The chroma plane is addressed in subsampled units, so the source
+	 * origin has to fall on a chroma sample.
+	 */
+	fmt = state->fb->format;
+	if (state->visible && fmt->is_yuv &&
+	    (((state->src.x1 >> 16) % fmt->hsub) != 0 ||
+	    ((state->src.y1 >> 16) % fmt->vsub) != 0))
+		return (-EINVAL);
+
+	return (0);
 }
 
 static void
@@ -157,6 +202,7 @@ static void
 rk_vop_plane_atomic_update(struct drm_plane *plane,
     struct drm_plane_state *old_state)
 {
+	const struct drm_format_info *fmt;
 	struct drm_plane_state *state;
 	struct rk_vop_plane *vop_plane;
 	struct rk_vop_softc *sc;
@@ -217,14 +263,13 @@ rk_vop_plane_atomic_update(struct drm_plane *plane,
 	else
 		VOP_WRITE(sc, RK3399_WIN2_DSP_INFO0, reg);
 
-	for (i = 0; i < nitems(rk_vop_plane_formats); i++)
-		if (rk_vop_plane_formats[i] == state->fb->format->format)
-			break;
-
-	rgb_mode = vop_convert_format(rk_vop_plane_formats[i]);
+	fmt = state->fb->format;
+	rgb_mode = vop_convert_format(fmt->format);
 	dprintf("fmt %d\n", rgb_mode);
 
-	if (dst_w <= 1280)
+	if (fmt->is_yuv)
+		lb_mode = dst_w > 1280 ? LB_YUV_3840X5 : LB_YUV_2560X8;
+	else if (dst_w <= 1280)
 		lb_mode = LB_RGB_1280X8;
 	else if (dst_w <= 1920)
 		lb_mode = LB_RGB_1920X5;
@@ -236,7 +281,20 @@ rk_vop_plane_atomic_update(struct drm_plane *plane,
 		panic("unknown lb_mode, dst_w %d", dst_w);
 
 	if (id == 0) {
-		VOP_WRITE(sc, RK3399_WIN0_VIR, state->fb->pitches[0] >> 2);
+		reg = WIN0_VIR_YRGB(state->fb->pitches[0] >> 2);
+		if (fmt->is_yuv)
+			reg |= WIN0_VIR_CBR(state->fb->pitches[1] >> 2);
+		VOP_WRITE(sc, RK3399_WIN0_VIR, reg);
+
+		reg = VOP_READ(sc, RK3399_YUV2YUV_WIN);
+		if (fmt->is_yuv) {
+			for (i = 0; i < nitems(rk_vop_bt601_y2r); i++)
+				VOP_WRITE(sc, RK3399_WIN0_YUV2YUV_Y2R + i * 4,
+				    rk_vop_bt601_y2r[i]);
+			reg |= YUV2YUV_WIN0_Y2R_EN;
+		} else
+			reg &= ~YUV2YUV_WIN0_Y2R_EN;
+		VOP_WRITE(sc, RK3399_YUV2YUV_WIN, reg);
 
 		reg = VOP_READ(sc, RK3399_WIN0_CTRL0);
 		reg &= ~WIN0_CTRL0_LB_MODE_M;
@@ -281,10 +339,21 @@ rk_vop_plane_atomic_update(struct drm_plane *plane,
 	else
 		VOP_WRITE(sc, RK3399_WIN2_MST0, paddr);
 
+	/* Chroma plane, scanned out straight from the client buffer. */
+	if (id == 0 && fmt->is_yuv) {
+		bo = drm_fb_cma_get_gem_obj(fb, 1);
+		paddr = bo->pbase + fb->drm_fb.offsets[1];
+		paddr += (state->src.x1 >> 16) / fmt->hsub * fmt->cpp[1];
+		paddr += (state->src.y1 >> 16) / fmt->vsub *
+		    fb->drm_fb.pitches[1];
+		VOP_WRITE(sc, RK3399_WIN0_CBR_MST, paddr);
+	}
+
 	VOP_WRITE(sc, RK3399_REG_CFG_DONE, 1);
 }
 
 static struct drm_plane_helper_funcs rk_vop_plane_helper_funcs = {
+	.prepare_fb	= drm_gem_fb_flush_prepare_fb,
 	.atomic_check	= rk_vop_plane_atomic_check,
 	.atomic_disable	= rk_vop_plane_atomic_disable,
 	.atomic_update	= rk_vop_plane_atomic_update,
@@ -303,6 +372,8 @@ int
 rk_plane_create(struct rk_vop_softc *sc, struct drm_device *drm)
 {
 	enum drm_plane_type type;
+	const u32 *formats;
+	u_int nformats;
 	int error;
 	int i;
 
@@ -314,12 +385,19 @@ rk_plane_create(struct rk_vop_softc *sc, struct drm_device *drm)
 		else
 			type = DRM_PLANE_TYPE_CURSOR;
 
+		if (i == 0) {
+			formats = rk_vop_win0_formats;
+			nformats = nitems(rk_vop_win0_formats);
+		} else {
+			formats = rk_vop_win2_formats;
+			nformats = nitems(rk_vop_win2_formats);
+		}
+
 		error = drm_universal_plane_init(drm,
 		    &sc->planes[i].plane,
 		    0,
 		    &rk_vop_plane_funcs,
-		    rk_vop_plane_formats,
-		    nitems(rk_vop_plane_formats),
+		    formats, nformats,
 		    NULL, type, NULL);
 		if (error != 0) {
 			device_printf(sc->dev, "Could not init plane.");
@@ -327,6 +405,7 @@ rk_plane_create(struct rk_vop_softc *sc, struct drm_device *drm)
 		}
 		drm_plane_helper_add(&sc->planes[i].plane,
 		    &rk_vop_plane_helper_funcs);
+		drm_plane_enable_fb_damage_clips(&sc->planes[i].plane);
 
 		sc->planes[i].sc = sc;
 		sc->planes[i].id = i;
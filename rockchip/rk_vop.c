@@ -244,7 +244,6 @@ rk_vop_intr(void *arg)
 	VOP_WRITE(sc, RK3399_INTR_CLEAR0, ~0);
 
 	if (status & INTR_STATUS0_FS_INTR) {
-		atomic_add_32(&sc->vbl_counter, 1);
 		drm_crtc_handle_vblank(&sc->crtc);
 		status &= ~INTR_STATUS0_FS_INTR;
 	}
@@ -352,18 +351,6 @@ rk_vop_disable_vblank(struct drm_crtc *crtc)
 	VOP_WRITE(sc, RK3399_INTR_EN0, reg);
 }
 
-static uint32_t
-rk_vop_get_vblank_counter(struct drm_crtc *crtc)
-{
-	struct rk_vop_softc *sc;
-
-	dprintf("%s\n", __func__);
-
-	sc = container_of(crtc, struct rk_vop_softc, crtc);
-
-	return (sc->vbl_counter);
-}
-
 static const struct drm_crtc_funcs rk_vop_funcs = {
 	.atomic_destroy_state	= drm_atomic_helper_crtc_destroy_state,
 	.atomic_duplicate_state	= drm_atomic_helper_crtc_duplicate_state,
@@ -372,7 +359,6 @@ static const struct drm_crtc_funcs rk_vop_funcs = {
 	.reset			= drm_atomic_helper_crtc_reset,
 	.set_config		= drm_atomic_helper_set_config,
 
-	.get_vblank_counter	= rk_vop_get_vblank_counter,
 	.enable_vblank		= rk_vop_enable_vblank,
 	.disable_vblank		= rk_vop_disable_vblank,
 
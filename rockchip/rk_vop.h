@@ -72,6 +72,8 @@
 #define	RK3399_WIN0_VIR				0x003c
 #define	 WIN0_VIR_WIDTH_RGB888(x)	((((((x) * 3) >> 2) + ((x) % 3)) & 0x3fff) << 0)
 #define	 WIN0_VIR_WIDTH_ARGB888(x)	(((x) & 0x3fff) << 0)
+#define	 WIN0_VIR_YRGB(x)		(((x) & 0x3fff) << 0)
+#define	 WIN0_VIR_CBR(x)		(((x) & 0x3fff) << 16)
 #define	RK3399_WIN0_YRGB_MST			0x0040
 #define	RK3399_WIN0_CBR_MST			0x0044
 #define	RK3399_WIN0_ACT_INFO			0x0048
@@ -103,7 +105,7 @@
 
 #define	RK3399_WIN2_CTRL0			0x00b0
 #define	 WIN2_CTRL0_DATA_FMT_S			5
-#define	 WIN2_CTRL0_DATA_FMT_M			(0x3 << WIN0_CTRL0_DATA_FMT_S)
+#define	 WIN2_CTRL0_DATA_FMT_M			(0x3 << WIN2_CTRL0_DATA_FMT_S)
 #define	 WIN2_CTRL0_EN				(1 << 4)
 #define	 WIN2_CTRL0_GATE			(1 << 0)
 #define	RK3399_WIN2_CTRL1			0x00b4
@@ -236,6 +238,7 @@
 #define	RK3399_WIN2_DSP_BG			0x02b8
 #define	RK3399_WIN3_DSP_BG			0x02bc
 #define	RK3399_YUV2YUV_WIN			0x02c0
+#define	 YUV2YUV_WIN0_Y2R_EN			(1 << 1)
 #define	RK3399_YUV2YUV_POST			0x02c4
 #define	RK3399_AUTO_GATING_EN			0x02cc
 #define	RK3399_WIN0_CSC_COE			0x03a0
@@ -318,7 +321,6 @@ struct rk_vop_softc {
 	struct drm_device		*drm;
 	struct drm_crtc			crtc;
 	struct drm_encoder		encoder;
-	uint32_t			vbl_counter;
 	device_t			outport;
 	void				*intrhand;
 };